@@ -0,0 +1,102 @@
+// Heap allocation report for the response path, used by the bench_alloc
+// Makefile target.
+//
+// usage: alloc config.conf [rounds]   (run from the repository root)
+//
+// Serves a few typical requests in process the way Servers::handleResponse
+// does, on one Connection reused like a keep-alive one, and counts operator
+// new calls per phase. serialize is queueing the response on the Connection.
+
+#include "../inc/AllHeaders.hpp"
+#include "../inc/Arena.hpp"
+#include "../inc/Connection.hpp"
+#include "bench.hpp"
+#include <cstdio>
+#include <cstdlib>
+
+enum Phase
+{
+    PHASE_PARSE,
+    PHASE_CONFIG,
+    PHASE_BUILD,
+    PHASE_SERIALIZE,
+    PHASE_COUNT
+};
+
+static const char *g_phases[PHASE_COUNT] = {"parse", "config", "build", "serialize"};
+
+struct Probe
+{
+    const char *name;
+    const char *raw;
+};
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::fprintf(stderr, "usage: alloc config.conf [rounds]\n");
+        return 1;
+    }
+    int rounds = argc > 2 ? std::atoi(argv[2]) : 200;
+    ConfigDB configDB;
+    configDB.execParser(argv);
+    ConfigSnapshot *snapshot = configDB.acquireSnapshot();
+    std::cout.setstate(std::ios::failbit); // the response path logs to stdout
+
+    Probe probes[] = {
+        {"static GET", "GET /index.html HTTP/1.1\r\nHost: localhost\r\nAccept: */*\r\n\r\n"},
+        {"directory GET", "GET / HTTP/1.1\r\nHost: localhost\r\nAccept: */*\r\n\r\n"},
+        {"404", "GET /nothere.html HTTP/1.1\r\nHost: localhost\r\n\r\n"},
+        {"HEAD", "HEAD /index.html HTTP/1.1\r\nHost: localhost\r\n\r\n"},
+    };
+    Listen host_port("127.0.0.1", 8000);
+    Connection conn(-1, -1);
+    HttpRequest &request = conn.getRequest();
+    Arena &arena = conn.getArena();
+
+    std::printf("%-14s", "allocs/request");
+    for (int p = 0; p < PHASE_COUNT; ++p)
+        std::printf(" %10s", g_phases[p]);
+    std::printf(" %10s\n", "total");
+    for (size_t i = 0; i < sizeof(probes) / sizeof(probes[0]); ++i)
+    {
+        unsigned long counts[PHASE_COUNT] = {0};
+        for (int r = -1; r < rounds; ++r)
+        {
+            if (r == 0) // the first round fills static tables, it is not counted
+                std::fill(counts, counts + PHASE_COUNT, 0);
+            std::string read = probes[i].raw;
+            unsigned long mark = g_allocs;
+            request.reset();
+            request.parseRequest(read);
+            counts[PHASE_PARSE] += g_allocs - mark;
+
+            arena.reset();
+            mark = g_allocs;
+            {
+                Client client(*snapshot, host_port, request, 0, REQUEST_COMPLETE, arena);
+                counts[PHASE_CONFIG] += g_allocs - mark;
+                mark = g_allocs;
+                client.setKeepAlive(true);
+                client.setupResponse();
+                counts[PHASE_BUILD] += g_allocs - mark;
+                mark = g_allocs;
+                conn.takeResponse(client.getResponseString());
+                counts[PHASE_SERIALIZE] += g_allocs - mark;
+            }
+            conn.consume(static_cast<size_t>(-1));
+        }
+        unsigned long total = 0;
+        std::printf("%-14s", probes[i].name);
+        for (int p = 0; p < PHASE_COUNT; ++p)
+        {
+            std::printf(" %10.1f", (double)counts[p] / rounds);
+            total += counts[p];
+        }
+        std::printf(" %10.1f\n", (double)total / rounds);
+    }
+    std::printf("arena: %lu bytes in %lu blocks\n", (unsigned long)arena.capacity(), (unsigned long)arena.blocks());
+    snapshot->release();
+    return 0;
+}
@@ -0,0 +1,32 @@
+// Counting replacement of the global operator new, linked into the
+// benchmarks that report heap allocations
+
+#include "bench.hpp"
+#include <cstdlib>
+#include <new>
+
+unsigned long g_allocs = 0;
+
+void *operator new(size_t size) throw(std::bad_alloc)
+{
+    g_allocs++;
+    void *p = std::malloc(size ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void *operator new[](size_t size) throw(std::bad_alloc)
+{
+    return operator new(size);
+}
+
+void operator delete(void *p) throw()
+{
+    std::free(p);
+}
+
+void operator delete[](void *p) throw()
+{
+    std::free(p);
+}
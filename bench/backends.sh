@@ -0,0 +1,40 @@
+#!/bin/sh
+# A/B throughput of the epoll and io_uring backends on the same keep-alive
+# GET workload, optionally pipelining depth requests per connection.
+# usage: bench/backends.sh [connections] [seconds] [path] [depth]
+
+CONNS=${1:-64}
+SECS=${2:-5}
+URI=${3:-/}
+DEPTH=${4:-1}
+PORT=18080
+CONF=$(mktemp /tmp/webserv_bench.XXXXXX)
+
+trap 'rm -f "$CONF"' EXIT
+
+for BACKEND in epoll io_uring; do
+    cat > "$CONF" <<CONFIG
+events {
+  use $BACKEND;
+  epoll_events 512;
+}
+http {
+  keepalive_timeout 65;
+  keepalive_requests 100000;
+}
+server {
+  listen $PORT;
+  root www;
+  location / {
+    index index.html;
+  }
+}
+CONFIG
+    ./webserv "$CONF" > /dev/null 2>&1 &
+    PID=$!
+    sleep 1
+    printf "%-9s " "$BACKEND"
+    ./bench/loadgen "$PORT" "$CONNS" "$SECS" "$URI" "$DEPTH"
+    kill "$PID"
+    wait "$PID" 2> /dev/null || true
+done
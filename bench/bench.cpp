@@ -0,0 +1,78 @@
+#include "bench.hpp"
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <unistd.h>
+
+double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+double budgetArg(int argc, char **argv, int index, double fallback)
+{
+    return argc > index ? std::atof(argv[index]) : fallback;
+}
+
+// Lines longer than the buffer are cut, the generated ones are short
+void appendf(std::string &out, const char *format, ...)
+{
+    char buf[512];
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+    if (len > 0)
+        out.append(buf, static_cast<size_t>(len) < sizeof(buf) ? len : sizeof(buf) - 1);
+}
+
+TempConfig::TempConfig(const char *name) : created_(false)
+{
+    std::snprintf(path_, sizeof(path_), "/tmp/webserv_bench_%s.XXXXXX", name);
+    args_[0] = const_cast<char *>("bench");
+    args_[1] = path_;
+    args_[2] = NULL;
+}
+
+TempConfig::~TempConfig()
+{
+    if (created_)
+        std::remove(path_);
+}
+
+// Replaces the whole file with text, false with a message if it failed
+bool TempConfig::write(const std::string &text)
+{
+    if (!created_)
+    {
+        int fd = mkstemp(path_);
+        if (fd == -1)
+        {
+            std::perror(path_);
+            return false;
+        }
+        close(fd);
+        created_ = true;
+    }
+    FILE *file = std::fopen(path_, "w");
+    if (!file)
+    {
+        std::perror(path_);
+        return false;
+    }
+    bool written = std::fwrite(text.data(), 1, text.size(), file) == text.size();
+    if (std::fclose(file) != 0 || !written)
+    {
+        std::perror(path_);
+        return false;
+    }
+    return true;
+}
+
+char **TempConfig::args()
+{
+    return args_;
+}
@@ -0,0 +1,45 @@
+#ifndef BENCH_HPP
+#define BENCH_HPP
+
+#include <string>
+
+// Helpers shared by the benchmarks of the bench_* Makefile targets
+
+// Seconds on the monotonic clock, for intervals only
+double now();
+
+// Seconds per case from argv[index], fallback when it is not given
+double budgetArg(int argc, char **argv, int index, double fallback);
+
+// printf onto the end of out, for the generated configs
+void appendf(std::string &out, const char *format, ...);
+
+/**
+ * @brief Config file a benchmark generates, size after size.
+ *
+ * The file gets a mkstemp name on the first write, so concurrent runs never
+ * share it, and is removed with the object, early returns included.
+ */
+class TempConfig
+{
+public:
+    explicit TempConfig(const char *name);
+    ~TempConfig();
+
+    bool write(const std::string &text);
+    char **args();
+
+private:
+    TempConfig(const TempConfig &other);
+    TempConfig &operator=(const TempConfig &other);
+
+    char path_[64];
+    char *args_[3]; // argv for ConfigDB::execParser
+    bool created_;
+};
+
+// operator new calls so far, counted by bench/allocs.cpp; only the
+// benchmarks linked with it may use it
+extern unsigned long g_allocs;
+
+#endif
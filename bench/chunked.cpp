@@ -0,0 +1,162 @@
+// Chunked request body decoding benchmark used by the bench_chunked Makefile target.
+//
+// usage: chunked [body_mb] [rounds]
+//
+// Encodes a body with tiny (1-16 byte), mixed and large chunks, then feeds
+// it in 16 KB reads to HttpRequest and to the find/substr/istringstream
+// loop the parser used before. Bodies stay in memory so only decoding is
+// measured. Checks the chunk size line limit first.
+
+#include "../inc/HttpRequest.hpp"
+#include "bench.hpp"
+#include <cstdio>
+#include <cstdlib>
+
+#define READ_SIZE 16384
+
+// Chunk sizes drawn from [min, max]
+static std::string encode(size_t body_size, size_t min, size_t max)
+{
+    std::string out = "POST /upload HTTP/1.1\r\nHost: bench\r\nTransfer-Encoding: chunked\r\n\r\n";
+    size_t left = body_size;
+    unsigned seed = 42;
+    while (left > 0)
+    {
+        seed = seed * 1103515245 + 12345;
+        size_t size = std::min(left, min + (seed >> 8) % (max - min + 1));
+        char line[32];
+        std::snprintf(line, sizeof(line), "%zx\r\n", size);
+        out += line;
+        out.append(size, 'x');
+        out += "\r\n";
+        left -= size;
+    }
+    return out + "0\r\n\r\n";
+}
+
+// The decoder before the byte-driven one: a line search, a substr and an
+// istringstream per chunk size. Returns the decoded body size.
+static size_t legacyDecode(const std::string &request)
+{
+    std::string buffer;
+    std::string body;
+    size_t pos = request.find("\r\n\r\n") + 4;
+    size_t chunk = 0;
+    bool inData = false;
+
+    buffer.assign(request, 0, pos);
+    for (size_t off = pos; off < request.size(); off += READ_SIZE)
+    {
+        buffer.append(request, off, READ_SIZE);
+        while (pos < buffer.size())
+        {
+            if (inData)
+            {
+                size_t take = std::min(chunk, buffer.size() - pos);
+                body.append(buffer, pos, take);
+                pos += take;
+                chunk -= take;
+                if (chunk > 0 || buffer.size() - pos < 2)
+                    break;
+                pos += 2;
+                inData = false;
+                continue;
+            }
+            size_t end = buffer.find("\r\n", pos);
+            if (end == std::string::npos)
+                break;
+            std::istringstream hex(buffer.substr(pos, end - pos));
+            hex >> std::hex >> chunk;
+            pos = end + 2;
+            if (chunk == 0)
+                return body.size();
+            inData = true;
+        }
+    }
+    return body.size();
+}
+
+// Status parseRequest ends with once raw is fed in READ_SIZE reads
+static int requestStatus(HttpRequest &request, const std::string &raw)
+{
+    std::string read;
+    int status = REQUEST_INCOMPLETE;
+    request.reset();
+    for (size_t off = 0; off < raw.size() && status == REQUEST_INCOMPLETE; off += READ_SIZE)
+    {
+        read.assign(raw, off, READ_SIZE);
+        status = request.parseRequest(read);
+        if (status == REQUEST_HEADERS_DONE)
+            status = request.parseRequest(read);
+    }
+    return status;
+}
+
+static size_t requestDecode(HttpRequest &request, const std::string &raw)
+{
+    return requestStatus(request, raw) == REQUEST_COMPLETE ? request.getBody().size() : 0;
+}
+
+// Size lines up to CHUNK_LINE_MAX bytes pass, longer ones get 400 even
+// when leading zeros keep their value small
+static bool checkSizeLineLimit(HttpRequest &request)
+{
+    const std::string head = "POST /upload HTTP/1.1\r\nHost: bench\r\nTransfer-Encoding: chunked\r\n\r\n";
+    const std::string tail = "\r\nx\r\n0\r\n\r\n";
+    std::string longest = std::string(CHUNK_LINE_MAX - 1, '0') + "1";
+    std::string over = std::string(CHUNK_LINE_MAX, '0') + "1";
+
+    if (requestDecode(request, head + longest + tail) != 1)
+    {
+        std::fprintf(stderr, "%d byte chunk size line refused\n", CHUNK_LINE_MAX);
+        return false;
+    }
+    if (requestStatus(request, head + over + tail) != 400)
+    {
+        std::fprintf(stderr, "%d byte chunk size line accepted\n", CHUNK_LINE_MAX + 1);
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    size_t body_size = (argc > 1 ? std::atol(argv[1]) : 8) * 1024 * 1024;
+    int rounds = argc > 2 ? std::atoi(argv[2]) : 10;
+    struct Profile
+    {
+        const char *name;
+        size_t min;
+        size_t max;
+    } profiles[] = {
+        {"tiny 1-16", 1, 16},
+        {"small 64-512", 64, 512},
+        {"large 64k", 65536, 65536},
+    };
+    HttpRequest request;
+    request.setBodyBuffer(body_size + 1, "/tmp");
+    if (!checkSizeLineLimit(request))
+        return 1;
+
+    for (size_t p = 0; p < sizeof(profiles) / sizeof(profiles[0]); ++p)
+    {
+        std::string raw = encode(body_size, profiles[p].min, profiles[p].max);
+        std::printf("%-13s %6.1f MB encoded\n", profiles[p].name, raw.size() / 1e6);
+
+        double start = now();
+        size_t decoded = 0;
+        for (int r = 0; r < rounds; ++r)
+            decoded += legacyDecode(raw);
+        double legacy = now() - start;
+
+        start = now();
+        size_t checked = 0;
+        for (int r = 0; r < rounds; ++r)
+            checked += requestDecode(request, raw);
+        double current = now() - start;
+
+        std::printf("  legacy   %8.0f MB/s  (%zu bytes)\n", raw.size() * rounds / legacy / 1e6, decoded / rounds);
+        std::printf("  decoder  %8.0f MB/s  (%zu bytes)\n", raw.size() * rounds / current / 1e6, checked / rounds);
+    }
+    return 0;
+}
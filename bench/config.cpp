@@ -0,0 +1,101 @@
+// Per-request config cost against config size, used by the bench_config
+// Makefile target.
+//
+// usage: config [seconds_per_case]   (run from the repository root)
+//
+// Writes configs of one server with 1 to 500 locations, then times what a
+// request pays for its config: the copy of the whole database each
+// response used to make, against resolving the request's location from
+// the shared ConfigSnapshot as Client does now. The request targets the
+// middle location.
+
+#include "../inc/AllHeaders.hpp"
+#include "../inc/Arena.hpp"
+#include "bench.hpp"
+#include <cstdio>
+#include <cstdlib>
+
+static std::string configText(int locations)
+{
+    std::string config;
+    appendf(config, "server {\n  listen 8000;\n  root www;\n  cgi .sh .py;\n");
+    appendf(config, "  error_page 404 /errors/404.html;\n  error_page 403 /errors/403.html;\n");
+    for (int i = 0; i < locations; ++i)
+    {
+        appendf(config, "  location /loc%d {\n    root www;\n    index index.html;\n", i);
+        appendf(config, "    autoindex off;\n    limit_except GET POST;\n    client_max_body_size 1M;\n  }\n");
+    }
+    appendf(config, "}\n");
+    return config;
+}
+
+struct Cost
+{
+    double ns;
+    double allocs;
+};
+
+static Cost copyDatabase(const ConfigDB &configDB, double budget)
+{
+    unsigned long rounds = 0;
+    unsigned long allocs = g_allocs;
+    double start = now();
+    while (now() - start < budget)
+    {
+        GroupedDBMap servers = configDB.getServers();
+        GroupedDBMap root = configDB.getRootConfig();
+        rounds++;
+    }
+    Cost cost = {(now() - start) * 1e9 / rounds, (double)(g_allocs - allocs) / rounds};
+    return cost;
+}
+
+static Cost resolve(const ConfigSnapshot &snapshot, HttpRequest &request, double budget)
+{
+    Listen host_port("127.0.0.1", 8000);
+    Arena arena;
+    unsigned long rounds = 0;
+    unsigned long allocs = g_allocs;
+    double start = now();
+    while (now() - start < budget)
+    {
+        arena.reset();
+        Client client(snapshot, host_port, request, 0, REQUEST_COMPLETE, arena);
+        rounds++;
+    }
+    Cost cost = {(now() - start) * 1e9 / rounds, (double)(g_allocs - allocs) / rounds};
+    return cost;
+}
+
+int main(int argc, char **argv)
+{
+    double budget = budgetArg(argc, argv, 1, 0.3);
+    const int sizes[] = {1, 10, 100, 250, 500};
+    TempConfig config("config");
+
+    std::printf("%-10s %14s %12s %14s %12s\n", "locations", "db copy ns", "allocs", "snapshot ns", "allocs");
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i)
+    {
+        if (!config.write(configText(sizes[i])))
+            return 1;
+        ConfigDB configDB;
+        configDB.execParser(config.args());
+        ConfigSnapshot *snapshot = configDB.acquireSnapshot();
+
+        char raw[128];
+        std::snprintf(raw, sizeof(raw), "GET /loc%d/index.html HTTP/1.1\r\nHost: bench\r\n\r\n", sizes[i] / 2);
+        std::string read = raw;
+        HttpRequest request;
+        if (request.parseRequest(read) != REQUEST_COMPLETE)
+        {
+            std::fprintf(stderr, "bench request refused\n");
+            return 1;
+        }
+
+        Cost copy = copyDatabase(configDB, budget);
+        Cost shared = resolve(*snapshot, request, budget);
+        std::printf("%-10d %14.0f %12.1f %14.0f %12.1f\n", sizes[i], copy.ns, copy.allocs, shared.ns, shared.allocs);
+        snapshot->release();
+    }
+    return 0;
+}
@@ -0,0 +1,172 @@
+// Keep-alive GET load generator used by the bench_* Makefile targets.
+//
+// usage: loadgen <port> [connections] [seconds] [path] [depth]
+//
+// Every connection runs in its own thread and sends depth pipelined requests
+// at a time (1 by default), so the reported requests/sec is the closed-loop
+// throughput of the server.
+
+#include "bench.hpp"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+struct Job
+{
+    int port;
+    std::string request;
+    int depth;
+    double deadline;
+    unsigned long requests;
+    unsigned long errors;
+};
+
+static int connectTo(int port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd == -1)
+        return -1;
+    struct sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) == -1)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Reads one response; returns false when the server closed or broke framing.
+static bool readResponse(int fd, std::string &buffer, bool &keepAlive)
+{
+    size_t headerEnd;
+    char chunk[16384];
+    while ((headerEnd = buffer.find("\r\n\r\n")) == std::string::npos)
+    {
+        ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+        if (n <= 0)
+            return false;
+        buffer.append(chunk, n);
+    }
+    std::string headers = buffer.substr(0, headerEnd);
+    for (size_t i = 0; i < headers.size(); ++i)
+        headers[i] = std::tolower(headers[i]);
+    size_t pos = headers.find("content-length:");
+    if (pos == std::string::npos)
+        return false;
+    size_t length = std::strtoul(headers.c_str() + pos + 15, NULL, 10);
+    keepAlive = headers.find("connection: close") == std::string::npos;
+
+    size_t total = headerEnd + 4 + length;
+    while (buffer.size() < total)
+    {
+        ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+        if (n <= 0)
+            return false;
+        buffer.append(chunk, n);
+    }
+    buffer.erase(0, total);
+    return true;
+}
+
+static void *run(void *arg)
+{
+    Job *job = static_cast<Job *>(arg);
+    int fd = -1;
+    std::string buffer;
+
+    while (now() < job->deadline)
+    {
+        if (fd == -1)
+        {
+            buffer.clear();
+            if ((fd = connectTo(job->port)) == -1)
+            {
+                job->errors++;
+                usleep(1000);
+                continue;
+            }
+        }
+        bool keepAlive = true;
+        bool failed = send(fd, job->request.c_str(), job->request.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(job->request.size());
+        for (int i = 0; !failed && keepAlive && i < job->depth; ++i)
+        {
+            if (readResponse(fd, buffer, keepAlive))
+                job->requests++;
+            else
+                failed = true;
+        }
+        if (failed)
+        {
+            job->errors++;
+            close(fd);
+            fd = -1;
+            continue;
+        }
+        if (!keepAlive)
+        {
+            close(fd);
+            fd = -1;
+        }
+    }
+    if (fd != -1)
+        close(fd);
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::fprintf(stderr, "usage: %s <port> [connections] [seconds] [path] [depth]\n", argv[0]);
+        return 1;
+    }
+    int port = std::atoi(argv[1]);
+    int connections = argc > 2 ? std::atoi(argv[2]) : 16;
+    double seconds = argc > 3 ? std::atof(argv[3]) : 5;
+    std::string path = argc > 4 ? argv[4] : "/";
+    int depth = argc > 5 ? std::max(1, std::atoi(argv[5])) : 1;
+
+    std::vector<Job> jobs(connections);
+    std::vector<pthread_t> threads(connections);
+    double start = now();
+    for (int i = 0; i < connections; ++i)
+    {
+        jobs[i].port = port;
+        for (int j = 0; j < depth; ++j)
+            jobs[i].request += "GET " + path + " HTTP/1.1\r\nHost: localhost\r\n\r\n";
+        jobs[i].depth = depth;
+        jobs[i].deadline = start + seconds;
+        jobs[i].requests = 0;
+        jobs[i].errors = 0;
+        pthread_create(&threads[i], NULL, run, &jobs[i]);
+    }
+
+    unsigned long requests = 0;
+    unsigned long errors = 0;
+    for (int i = 0; i < connections; ++i)
+    {
+        pthread_join(threads[i], NULL);
+        requests += jobs[i].requests;
+        errors += jobs[i].errors;
+    }
+    double elapsed = now() - start;
+    std::printf("%lu requests, %lu errors, %.1fs, %.0f req/s\n", requests, errors, elapsed, requests / elapsed);
+    return 0;
+}
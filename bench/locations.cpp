@@ -0,0 +1,118 @@
+// Location matching benchmark used by the bench_locations Makefile target.
+//
+// usage: locations [seconds_per_case]   (run from the repository root)
+//
+// Writes one server with 10, 1k and 50k locations (prefix, ^~ and =),
+// loads it through ConfigDB, then matches a fixed mix of targets: deep
+// hits, exact hits and misses. The radix tree of ServerConfig::match is
+// timed against the longest-prefix scan it replaced, and both must pick
+// the same location for every target.
+
+#include "../inc/AllHeaders.hpp"
+#include "bench.hpp"
+#include <cstdio>
+#include <cstdlib>
+
+static volatile size_t g_sink; // keeps the matches from being optimized out
+
+static std::string locationPath(int i)
+{
+    char path[64];
+    if (i % 10 == 0)
+        std::snprintf(path, sizeof(path), "/api/v%d/item%d/status", i % 3, i);
+    else if (i % 7 == 0)
+        std::snprintf(path, sizeof(path), "/static/%d/", i);
+    else
+        std::snprintf(path, sizeof(path), "/api/v%d/item%d", i % 3, i);
+    return path;
+}
+
+static std::string configText(int locations)
+{
+    std::string config;
+    appendf(config, "server {\n  listen 8000;\n  root www;\n  location / {\n    autoindex on;\n  }\n");
+    for (int i = 1; i < locations; ++i)
+    {
+        const char *modifier = i % 10 == 0 ? "= " : i % 7 == 0 ? "^~ " : "";
+        appendf(config, "  location %s%s {\n    root www/%d;\n  }\n", modifier, locationPath(i).c_str(), i);
+    }
+    appendf(config, "}\n");
+    return config;
+}
+
+// The scan before the radix tree: every location is a prefix candidate
+static const LocationConfig &linearMatch(const ServerConfig &server, const std::string &target)
+{
+    const LocationConfig *best = &server.defaults;
+    for (size_t i = 0; i < server.locations.size(); ++i)
+    {
+        const LocationConfig &location = server.locations[i];
+        if (location.modifier == EXACT && location.path == target)
+            return location;
+        if (location.modifier != EXACT && location.path.size() > best->path.size() && target.compare(0, location.path.size(), location.path) == 0)
+            best = &location;
+    }
+    return *best;
+}
+
+static std::vector<std::string> targets(int locations)
+{
+    std::vector<std::string> out;
+    for (int k = 1; k <= 64; ++k)
+    {
+        int i = (int)((long)k * 7919 % locations);
+        std::string path = locationPath(i ? i : 1);
+        out.push_back(path);                   // exact or prefix hit
+        out.push_back(path + "/index.html");   // deep hit
+        out.push_back("/nothing/here/" + path); // only "/" matches
+    }
+    return out;
+}
+
+static double timeMatches(const ServerConfig &server, const std::vector<std::string> &list, bool linear, double budget)
+{
+    unsigned long lookups = 0;
+    double start = now();
+    while (now() - start < budget)
+    {
+        for (size_t i = 0; i < list.size(); ++i)
+            g_sink = (linear ? linearMatch(server, list[i]) : server.match(list[i])).path.size();
+        lookups += list.size();
+    }
+    return (now() - start) * 1e9 / lookups;
+}
+
+int main(int argc, char **argv)
+{
+    double budget = budgetArg(argc, argv, 1, 0.3);
+    const int sizes[] = {10, 1000, 50000};
+    TempConfig config("locations");
+
+    std::printf("%-10s %10s %12s %12s %12s\n", "locations", "nodes", "load ms", "radix ns", "linear ns");
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s)
+    {
+        if (!config.write(configText(sizes[s])))
+            return 1;
+        double start = now();
+        ConfigDB configDB;
+        configDB.execParser(config.args());
+        ConfigSnapshot *snapshot = configDB.acquireSnapshot();
+        double load = (now() - start) * 1e3;
+        const ServerConfig &server = snapshot->server(0);
+
+        std::vector<std::string> list = targets(sizes[s]);
+        for (size_t i = 0; i < list.size(); ++i)
+        {
+            if (&server.match(list[i]) != &linearMatch(server, list[i]))
+            {
+                std::fprintf(stderr, "%s: radix and linear matches differ\n", list[i].c_str());
+                return 1;
+            }
+        }
+        double radix = timeMatches(server, list, false, budget);
+        double linear = timeMatches(server, list, true, budget);
+        std::printf("%-10d %10lu %12.0f %12.0f %12.0f\n", sizes[s], (unsigned long)server.prefixes.size(), load, radix, linear);
+        snapshot->release();
+    }
+    return 0;
+}
@@ -0,0 +1,213 @@
+// Request parser benchmark used by the bench_parser Makefile target.
+//
+// usage: parser [corpus.jsonl] [seconds_per_case]
+//
+// Every corpus line is {"name": "...", "raw": "..."} holding one or more
+// requests as they arrive on the wire. Each case is parsed whole, then
+// split in two at every byte boundary, driving HttpRequest the way
+// Servers::processRequest does. Both runs must complete the same number of
+// requests. Reported per run: throughput, requests/s, heap allocations per
+// request (the read buffer the parser takes over included, as in the
+// server) and the p99 time to parse one request.
+
+#include "../inc/HttpRequest.hpp"
+#include "bench.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+
+#define SAMPLES_MAX (1 << 20)
+
+struct Case
+{
+    std::string name;
+    std::string raw;
+};
+
+struct Result
+{
+    unsigned long bytes;
+    unsigned long requests;
+    unsigned long allocs;
+    std::vector<double> samples; // nanoseconds per request
+};
+
+// Reads the JSON string starting at the quote at pos. Only the escapes
+// HTTP text needs are understood: \r \n \t \" \\ \/ and \u00XX.
+static bool jsonString(const std::string &line, size_t &pos, std::string &out)
+{
+    if (pos >= line.size() || line[pos] != '"')
+        return false;
+    out.clear();
+    for (++pos; pos < line.size() && line[pos] != '"'; ++pos)
+    {
+        if (line[pos] != '\\')
+        {
+            out += line[pos];
+            continue;
+        }
+        if (++pos >= line.size())
+            return false;
+        switch (line[pos])
+        {
+        case 'r': out += '\r'; break;
+        case 'n': out += '\n'; break;
+        case 't': out += '\t'; break;
+        case 'u':
+            if (pos + 4 >= line.size())
+                return false;
+            out += static_cast<char>(std::strtol(line.substr(pos + 1, 4).c_str(), NULL, 16));
+            pos += 4;
+            break;
+        default: out += line[pos];
+        }
+    }
+    return pos++ < line.size();
+}
+
+static bool jsonField(const std::string &line, const char *key, std::string &out)
+{
+    size_t pos = line.find(std::string("\"") + key + "\"");
+    if (pos == std::string::npos)
+        return false;
+    pos = line.find_first_not_of(" :", line.find(':', pos));
+    return pos != std::string::npos && jsonString(line, pos, out);
+}
+
+static bool loadCorpus(const char *path, std::vector<Case> &corpus)
+{
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line))
+    {
+        Case c;
+        if (line.empty())
+            continue;
+        if (!jsonField(line, "name", c.name) || !jsonField(line, "raw", c.raw))
+        {
+            std::fprintf(stderr, "%s: bad corpus line: %.60s\n", path, line.c_str());
+            return false;
+        }
+        corpus.push_back(c);
+    }
+    return !corpus.empty();
+}
+
+// Hands one read to the parser and returns how many requests it completed,
+// -1 on an error status
+static int feed(HttpRequest &request, std::string &read)
+{
+    int done = 0;
+    while (true)
+    {
+        int status = request.parseRequest(read);
+        if (status == REQUEST_HEADERS_DONE)
+            status = request.parseRequest(read);
+        if (status == REQUEST_INCOMPLETE)
+            return done;
+        if (status != REQUEST_COMPLETE)
+            return -1;
+        done++;
+        request.takeUnparsed(read);
+        request.reset();
+        if (read.empty())
+            return done;
+    }
+}
+
+// Parses raw delivered as [0, split) and [split, end), or whole for split 0.
+// Time spent on each completed request goes to result.samples.
+static int parseOnce(HttpRequest &request, const std::string &raw, size_t split, Result &result)
+{
+    std::string read;
+    size_t cuts[] = {0, split, raw.size()};
+    int total = 0;
+    double pending = 0;
+
+    for (int i = split ? 0 : 1; i < 2; ++i)
+    {
+        unsigned long allocs = g_allocs;
+        double start = now();
+        read.assign(raw, cuts[i], cuts[i + 1] - cuts[i]);
+        int done = feed(request, read);
+        pending += now() - start;
+        result.allocs += g_allocs - allocs;
+        if (done < 0)
+            return -1;
+        for (int r = 0; r < done; ++r)
+            result.samples.push_back(pending * 1e9 / done);
+        if (done)
+            pending = 0;
+        total += done;
+    }
+    return total;
+}
+
+static void report(const char *name, const char *mode, Result &result)
+{
+    std::sort(result.samples.begin(), result.samples.end());
+    double seconds = 0;
+    for (size_t i = 0; i < result.samples.size(); ++i)
+        seconds += result.samples[i] / 1e9;
+    double p99 = result.samples[result.samples.size() * 99 / 100];
+    std::printf("%-16s %-6s %8.1f MB/s %10.0f req/s %6.1f allocs/req  p99 %7.0f ns\n",
+                name, mode, result.bytes / seconds / 1e6, result.requests / seconds,
+                (double)result.allocs / result.requests, p99);
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = argc > 1 ? argv[1] : "bench/parser_corpus.jsonl";
+    double budget = budgetArg(argc, argv, 2, 0.5);
+    std::vector<Case> corpus;
+    if (!loadCorpus(path, corpus))
+    {
+        std::fprintf(stderr, "usage: parser [corpus.jsonl] [seconds_per_case]\n");
+        return 1;
+    }
+
+    HttpRequest request;
+    for (size_t c = 0; c < corpus.size(); ++c)
+    {
+        const std::string &raw = corpus[c].raw;
+        Result whole = Result();
+        Result split = Result();
+        int expected = parseOnce(request, raw, 0, whole);
+        if (expected <= 0)
+        {
+            std::fprintf(stderr, "%s: parser refused the request\n", corpus[c].name.c_str());
+            return 1;
+        }
+        // reserved up front so no sample lands in an allocation count
+        whole = Result();
+        whole.samples.reserve(SAMPLES_MAX);
+        split.samples.reserve(SAMPLES_MAX);
+
+        double start = now();
+        while (now() - start < budget && whole.samples.size() + expected <= SAMPLES_MAX)
+        {
+            parseOnce(request, raw, 0, whole);
+            whole.bytes += raw.size();
+            whole.requests += expected;
+        }
+        start = now();
+        do
+        {
+            for (size_t at = 1; at < raw.size(); ++at)
+            {
+                if (parseOnce(request, raw, at, split) != expected)
+                {
+                    std::fprintf(stderr, "%s: split at byte %zu parsed differently\n", corpus[c].name.c_str(), at);
+                    return 1;
+                }
+                split.bytes += raw.size();
+                split.requests += expected;
+            }
+        } while (now() - start < budget && split.samples.size() + 2 * raw.size() * expected <= SAMPLES_MAX);
+
+        report(corpus[c].name.c_str(), "whole", whole);
+        report(corpus[c].name.c_str(), "split", split);
+    }
+    return 0;
+}
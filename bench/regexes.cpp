@@ -0,0 +1,158 @@
+// Regex location benchmark used by the bench_regexes Makefile target.
+//
+// usage: regexes [seconds_per_case]   (run from the repository root)
+//
+// Writes one server with a few prefix locations and 1, 12 and 48 regex
+// locations (~ and ~*, anchored at the start, at the end or neither),
+// loads it through ConfigDB, then matches a mix of targets where most
+// hit no regex. ServerConfig::match, which checks each pattern's
+// literals before regexec, is timed against running regexec on every
+// regex location in order, and both must pick the same location.
+
+#include "../inc/AllHeaders.hpp"
+#include "bench.hpp"
+#include <cstdio>
+#include <cstdlib>
+
+static volatile size_t g_sink; // keeps the matches from being optimized out
+
+static std::string regexLocation(int i)
+{
+    char location[96];
+    if (i % 3 == 0)
+        std::snprintf(location, sizeof(location), "~ \\.ext%d$", i);
+    else if (i % 3 == 1)
+        std::snprintf(location, sizeof(location), "~* ^/app%d/(js|css)/", i);
+    else
+        std::snprintf(location, sizeof(location), "~ /api/v[0-9]+/res%d", i);
+    return location;
+}
+
+static std::string configText(int regexes)
+{
+    std::string config;
+    appendf(config, "server {\n  listen 8000;\n  root www;\n  location / {\n    autoindex on;\n  }\n");
+    appendf(config, "  location /static/ {\n    root www/static;\n  }\n  location ^~ /data {\n    root www/data;\n  }\n");
+    for (int i = 0; i < regexes; ++i)
+        appendf(config, "  location %s {\n    root www/%d;\n  }\n", regexLocation(i).c_str(), i);
+    appendf(config, "}\n");
+    return config;
+}
+
+// regexec on every regex location in config order, the prefix phase as
+// ServerConfig::match does it
+class Reference
+{
+public:
+    explicit Reference(const ServerConfig &server) : server_(server)
+    {
+        for (size_t i = 0; i < server.locations.size(); ++i)
+        {
+            const LocationConfig &location = server.locations[i];
+            if (!location.isRegex())
+                continue;
+            regex_t regex;
+            regcomp(&regex, location.path.c_str(), REG_EXTENDED | REG_NOSUB | (location.modifier == CASE_INSENSITIVE ? REG_ICASE : 0));
+            regexes_.push_back(regex);
+            indexes_.push_back(i);
+        }
+    }
+
+    ~Reference()
+    {
+        for (size_t i = 0; i < regexes_.size(); ++i)
+            regfree(&regexes_[i]);
+    }
+
+    const LocationConfig &match(const std::string &target) const
+    {
+        bool exact;
+        int found = server_.prefixes.match(target, exact);
+        if (exact || (found >= 0 && server_.locations[found].modifier == LONGEST))
+            return server_.locations[found];
+        for (size_t i = 0; i < regexes_.size(); ++i)
+        {
+            if (regexec(&regexes_[i], target.c_str(), 0, NULL, 0) == 0)
+                return server_.locations[indexes_[i]];
+        }
+        return found < 0 ? server_.defaults : server_.locations[found];
+    }
+
+private:
+    const ServerConfig &server_;
+    std::vector<regex_t> regexes_;
+    std::vector<size_t> indexes_;
+};
+
+static std::vector<std::string> targets(int regexes)
+{
+    std::vector<std::string> out;
+    char target[96];
+    for (int k = 0; k < 8; ++k)
+    {
+        int i = k * 7 % regexes;
+        std::snprintf(target, sizeof(target), "/files/report.ext%d", i);
+        out.push_back(target); // suffix hit or miss
+        std::snprintf(target, sizeof(target), "/APP%d/CSS/site.css", i);
+        out.push_back(target); // caseless prefix hit or miss
+        std::snprintf(target, sizeof(target), "/api/v2/res%d/7", i);
+        out.push_back(target); // infix hit or miss
+    }
+    for (int k = 0; k < 24; ++k)
+    {
+        std::snprintf(target, sizeof(target), "/static/img/%d/logo.png", k);
+        out.push_back(target); // no regex matches
+        std::snprintf(target, sizeof(target), "/index%d.html", k);
+        out.push_back(target);
+    }
+    out.push_back("/data/report.ext0"); // ^~ skips the regexes
+    return out;
+}
+
+template <class Matcher>
+static double timeMatches(const Matcher &matcher, const std::vector<std::string> &list, double budget)
+{
+    unsigned long lookups = 0;
+    double start = now();
+    while (now() - start < budget)
+    {
+        for (size_t i = 0; i < list.size(); ++i)
+            g_sink = matcher.match(list[i]).root.size();
+        lookups += list.size();
+    }
+    return (now() - start) * 1e9 / lookups;
+}
+
+int main(int argc, char **argv)
+{
+    double budget = budgetArg(argc, argv, 1, 0.3);
+    const int sizes[] = {1, 12, 48};
+    TempConfig config("regexes");
+
+    std::printf("%-10s %12s %12s %12s\n", "regexes", "targets", "literal ns", "regexec ns");
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s)
+    {
+        if (!config.write(configText(sizes[s])))
+            return 1;
+        ConfigDB configDB;
+        configDB.execParser(config.args());
+        ConfigSnapshot *snapshot = configDB.acquireSnapshot();
+        const ServerConfig &server = snapshot->server(0);
+        Reference reference(server);
+
+        std::vector<std::string> list = targets(sizes[s]);
+        for (size_t i = 0; i < list.size(); ++i)
+        {
+            if (&server.match(list[i]) != &reference.match(list[i]))
+            {
+                std::fprintf(stderr, "%s: prefiltered and plain regex matches differ\n", list[i].c_str());
+                return 1;
+            }
+        }
+        double literal = timeMatches(server, list, budget);
+        double plain = timeMatches(reference, list, budget);
+        std::printf("%-10d %12lu %12.0f %12.0f\n", sizes[s], (unsigned long)list.size(), literal, plain);
+        snapshot->release();
+    }
+    return 0;
+}
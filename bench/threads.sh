@@ -0,0 +1,38 @@
+#!/bin/sh
+# Throughput of worker_threads 1..MAX with a keep-alive GET load.
+# usage: bench/threads.sh [max_threads] [connections] [seconds]
+
+MAX=${1:-$(nproc)}
+CONNS=${2:-64}
+SECS=${3:-5}
+PORT=18080
+CONF=$(mktemp /tmp/webserv_bench.XXXXXX)
+
+trap 'rm -f "$CONF"' EXIT
+
+for THREADS in $(seq 1 "$MAX"); do
+    cat > "$CONF" <<CONFIG
+worker_threads $THREADS;
+events {
+  epoll_events 512;
+}
+http {
+  keepalive_timeout 65;
+  keepalive_requests 100000;
+}
+server {
+  listen $PORT;
+  root www;
+  location / {
+    index index.html;
+  }
+}
+CONFIG
+    ./webserv "$CONF" > /dev/null 2>&1 &
+    PID=$!
+    sleep 1
+    printf "worker_threads %-3s " "$THREADS"
+    ./bench/loadgen "$PORT" "$CONNS" "$SECS" /
+    kill "$PID"
+    wait "$PID" 2> /dev/null || true
+done
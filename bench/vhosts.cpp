@@ -0,0 +1,151 @@
+// Virtual host lookup benchmark used by the bench_vhosts Makefile target.
+//
+// usage: vhosts [seconds_per_case]
+//
+// Indexes 10, 500 and 10k server_name values (exact, *.example.com and
+// www.example.*) of one listener, then looks up a mix of Host values:
+// exact and wildcard hits, a port or upper case, and misses. The hash
+// index of VirtualHosts is timed against scanning every name with the
+// same priorities, and both must pick the same server.
+
+#include "../inc/VirtualHosts.hpp"
+#include "bench.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <strings.h>
+
+static volatile int g_sink; // keeps the lookups from being optimized out
+
+static std::string serverName(int i)
+{
+    char name[64];
+    if (i % 5 == 3)
+        std::snprintf(name, sizeof(name), "*.site%d.example.com", i);
+    else if (i % 5 == 4)
+        std::snprintf(name, sizeof(name), "www.shop%d.*", i);
+    else
+        std::snprintf(name, sizeof(name), "host%d.example.com", i);
+    return name;
+}
+
+static bool endsWith(const std::string &host, const std::string &suffix)
+{
+    return host.size() >= suffix.size() && strcasecmp(host.c_str() + host.size() - suffix.size(), suffix.c_str()) == 0;
+}
+
+// Every name compared in turn, as a list of names per listener would be
+class Scan
+{
+public:
+    void add(const std::string &name, int server)
+    {
+        names_.push_back(name);
+        servers_.push_back(server);
+    }
+
+    int find(const std::string &value) const
+    {
+        std::string host = value.substr(0, value.find(':'));
+        int best = -1;
+        size_t bestLength = 0;
+
+        for (size_t i = 0; i < names_.size(); ++i)
+        {
+            if (strcasecmp(names_[i].c_str(), host.c_str()) == 0)
+                return servers_[i];
+        }
+        for (size_t i = 0; i < names_.size(); ++i)
+        {
+            const std::string &name = names_[i];
+            if (name.compare(0, 2, "*.") == 0 && name.size() - 1 > bestLength && endsWith(host, name.substr(1)))
+            {
+                best = servers_[i];
+                bestLength = name.size() - 1;
+            }
+        }
+        if (best >= 0)
+            return best;
+        for (size_t i = 0; i < names_.size(); ++i)
+        {
+            const std::string &name = names_[i];
+            std::string head = name.substr(0, name.size() - 1);
+            if (endsWith(name, ".*") && head.size() > bestLength && host.size() > head.size() && strncasecmp(host.c_str(), head.c_str(), head.size()) == 0)
+            {
+                best = servers_[i];
+                bestLength = head.size();
+            }
+        }
+        return best;
+    }
+
+private:
+    std::vector<std::string> names_;
+    std::vector<int> servers_;
+};
+
+static std::vector<std::string> hosts(int names)
+{
+    std::vector<std::string> out;
+    char host[96];
+    for (int k = 0; k < 16; ++k)
+    {
+        int i = (int)((long)k * 7919 % names);
+        std::snprintf(host, sizeof(host), "host%d.example.com", i - i % 5);
+        out.push_back(host); // exact
+        std::snprintf(host, sizeof(host), "HOST%d.Example.com:8080", i - i % 5 + 1);
+        out.push_back(host); // exact, case and port
+        std::snprintf(host, sizeof(host), "a.b.site%d.example.com", i - i % 5 + 3);
+        out.push_back(host); // leading wildcard
+        std::snprintf(host, sizeof(host), "www.shop%d.co.uk", i - i % 5 + 4);
+        out.push_back(host); // trailing wildcard
+        std::snprintf(host, sizeof(host), "unknown%d.example.net", k);
+        out.push_back(host); // default server
+    }
+    return out;
+}
+
+template <class Index>
+static double timeLookups(const Index &index, const std::vector<std::string> &list, double budget)
+{
+    unsigned long lookups = 0;
+    double start = now();
+    while (now() - start < budget)
+    {
+        for (size_t i = 0; i < list.size(); ++i)
+            g_sink = index.find(list[i]);
+        lookups += list.size();
+    }
+    return (now() - start) * 1e9 / lookups;
+}
+
+int main(int argc, char **argv)
+{
+    double budget = budgetArg(argc, argv, 1, 0.3);
+    const int sizes[] = {10, 500, 10000};
+
+    std::printf("%-10s %12s %12s\n", "names", "hash ns", "scan ns");
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s)
+    {
+        VirtualHosts index;
+        Scan scan;
+        for (int i = 0; i < sizes[s]; ++i)
+        {
+            index.add(serverName(i), i);
+            scan.add(serverName(i), i);
+        }
+
+        std::vector<std::string> list = hosts(sizes[s]);
+        for (size_t i = 0; i < list.size(); ++i)
+        {
+            if (index.find(list[i]) != scan.find(list[i]))
+            {
+                std::fprintf(stderr, "%s: hash and scan lookups differ\n", list[i].c_str());
+                return 1;
+            }
+        }
+        double hash = timeLookups(index, list, budget);
+        double linear = timeLookups(scan, list, budget);
+        std::printf("%-10d %12.0f %12.0f\n", sizes[s], hash, linear);
+    }
+    return 0;
+}
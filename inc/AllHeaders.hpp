@@ -19,6 +19,7 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <deque>
 #include <fcntl.h>
 #include <fstream>
 #include <iomanip>
@@ -39,6 +40,7 @@
 #include <sys/socket.h>
 #include <sys/time.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #include <vector>
 #include <regex.h>
@@ -68,12 +70,6 @@ typedef std::map<std::string, VecStr> KeyValues;
 typedef std::pair<MapStr, VecStr> KeyMapValue;
 typedef std::map<int, std::vector<KeyMapValue> > GroupedDBMap;
 
-struct DB
-{
-  const GroupedDBMap serversDB;
-  const GroupedDBMap rootDB;
-};
-
 struct Listen
 {
   std::string ip_;
@@ -102,14 +98,17 @@ std::string getValue(const std::map<std::string, std::vector<std::string> > &key
 
 void printAllDBData(GroupedDBMap db);
 void printData(const std::vector<KeyMapValue> &values);
-std::vector<KeyMapValue> getDataByIdx(GroupedDBMap db, int index);
+const std::vector<KeyMapValue> &getDataByIdx(const GroupedDBMap &db, int index);
 bool setModifier(std::string &str);
 const std::string b64decode(const void *data, const size_t &len);
 std::string b64decode(const std::string &str64);
 std::string ftos(size_t num);
-std::string removeDupSlashes(std::string str);
+std::string removeDupSlashes(const std::string &str);
 std::string formatHttpDate(time_t timeValue);
 std::string get_http_date();
+uint64_t monotonicMsec();
+uint64_t parseMsec(const std::string &value);
+bool parseSize(const std::string &value, size_t &size);
 std::string md5(const std::string& input);
 std::string generateETagForFile(File& file);
 bool isMethodCharValid(char ch);
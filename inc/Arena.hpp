@@ -0,0 +1,114 @@
+#ifndef ARENA_HPP
+#define ARENA_HPP
+
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <new>
+
+#define ARENA_BLOCK_SIZE 16384 // bytes per block, larger requests get their own
+#define ARENA_ALIGN 16
+
+/**
+ * @brief Bump allocator for objects that live exactly as long as a request.
+ *
+ * Every Connection owns one. An allocation moves a pointer through the
+ * current block and nothing is freed on its own; reset() between
+ * keep-alive requests rewinds to the first block. Blocks are kept across
+ * resets, so once a connection's first request has warmed the arena the
+ * next ones take no memory from the heap for what lives in it.
+ */
+class Arena
+{
+public:
+    Arena();
+    ~Arena();
+
+    void *allocate(size_t size);
+    void reset();
+    size_t capacity() const;
+    size_t blocks() const;
+
+private:
+    // Header in front of each block's data
+    struct Block
+    {
+        Block *next;
+        size_t size;
+    };
+
+    Arena(const Arena &other);
+    Arena &operator=(const Arena &other);
+
+    void *nextBlock(size_t size);
+
+    Block *first_;
+    Block *current_;
+    char *ptr_; // next free byte of current_
+    char *end_;
+};
+
+/**
+ * @brief Standard allocator handing out Arena memory.
+ *
+ * deallocate() does nothing, the memory comes back with Arena::reset(), so
+ * a container using it must not outlive the request.
+ */
+template <typename T>
+class ArenaAllocator
+{
+public:
+    typedef T value_type;
+    typedef T *pointer;
+    typedef const T *const_pointer;
+    typedef T &reference;
+    typedef const T &const_reference;
+    typedef size_t size_type;
+    typedef ptrdiff_t difference_type;
+
+    template <typename U>
+    struct rebind
+    {
+        typedef ArenaAllocator<U> other;
+    };
+
+    explicit ArenaAllocator(Arena &arena) : arena_(&arena) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other) : arena_(other.arena()) {}
+
+    pointer allocate(size_type n, const void * = 0) { return static_cast<pointer>(arena_->allocate(n * sizeof(T))); }
+    void deallocate(pointer, size_type) {}
+    size_type max_size() const { return static_cast<size_type>(-1) / sizeof(T); }
+    void construct(pointer p, const T &value) { new (p) T(value); }
+    void destroy(pointer p) { p->~T(); }
+    pointer address(reference r) const { return &r; }
+    const_pointer address(const_reference r) const { return &r; }
+    Arena *arena() const { return arena_; }
+
+private:
+    Arena *arena_;
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b)
+{
+    return a.arena() == b.arena();
+}
+
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b)
+{
+    return a.arena() != b.arena();
+}
+
+// std::map whose nodes live in an Arena
+template <typename K, typename V>
+struct ArenaMap
+{
+    typedef std::map<K, V, std::less<K>, ArenaAllocator<std::pair<const K, V> > > type;
+};
+
+// Placement in an Arena; the object's destructor must still be called
+#define ARENA_NEW(arena, T) new ((arena).allocate(sizeof(T))) T
+
+#endif
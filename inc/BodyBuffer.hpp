@@ -0,0 +1,47 @@
+#ifndef BODY_BUFFER_HPP
+#define BODY_BUFFER_HPP
+
+#include <string>
+#include <sys/types.h>
+
+#define DEFAULT_CLIENT_BODY_BUFFER_SIZE 16384
+#define DEFAULT_CLIENT_BODY_TEMP_PATH "/tmp"
+#define BODY_STREAM_CHUNK 65536 // bytes moved per step when a body is copied out
+
+/**
+ * @brief Request body, in memory up to a threshold and in a temp file beyond.
+ *
+ * The parser appends decoded body bytes as they arrive. Once the body would
+ * outgrow client_body_buffer_size it moves to an already unlinked file under
+ * client_body_temp_path, so an upload costs a bounded amount of memory
+ * whatever its size. Handlers stream it back out with read() or writeTo().
+ */
+class BodyBuffer
+{
+public:
+    BodyBuffer();
+    ~BodyBuffer();
+
+    void configure(size_t memory_max, const std::string &temp_path);
+    bool append(const char *data, size_t len);
+    void clear();
+
+    size_t size() const;
+    bool inFile() const;
+    ssize_t read(size_t offset, char *buf, size_t len) const;
+    bool writeTo(int fd) const;
+
+private:
+    BodyBuffer(const BodyBuffer &other);
+    BodyBuffer &operator=(const BodyBuffer &other);
+
+    bool spill();
+
+    std::string memory_;
+    size_t memory_max_;
+    std::string temp_path_;
+    int fd_; // -1 while the body fits in memory_
+    size_t size_;
+};
+
+#endif
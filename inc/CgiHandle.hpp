@@ -30,7 +30,7 @@ class CgiHandle{
 		char 		*_path;
 		int			pipe_in[2];
 		int			pipe_out[2];
-		int			content_length;
+		size_t		content_length;
 		
 	public:
 		CgiHandle();
@@ -43,16 +43,18 @@ class CgiHandle{
 		void	execCgi();
 		int		setPipe();
 		void	closePipe();
+		void	closePipeIn();
+		void	closeFd(int &fd);
 		std::string getIp();
 		int getPipeIn();
 		int getPipeOut();
 		int getExitStatus();
 		std::string getExecPath();
-		int getContentLength();
+		size_t getContentLength();
 		int getPid();
 		void setPath();
 		void setArgv();
-		void deductContentLength(int length);
+		void deductContentLength(size_t length);
 		std::string	checkShebang();
 };
 
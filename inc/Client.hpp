@@ -3,9 +3,6 @@
 
 #include "AllHeaders.hpp"
 
-#define START_TIMEOUT 300
-#define LAST_TIMEOUT 150
-
 typedef std::map<std::string, std::string> MapStr;
 typedef std::vector<std::string> VecStr;
 typedef std::map<std::string, VecStr> KeyValues;
@@ -15,28 +12,35 @@ typedef std::map<int, std::vector<KeyMapValue> > GroupedDBMap;
 class RequestConfig;
 class InputArgs;
 class HttpResponse;
-struct DB;
+class ConfigSnapshot;
+class Arena;
 
 class Client
 {
 public:
-    Client(DB &db, Listen &host_port, HttpRequest &req_, size_t targetServerIdx, int status);
+    Client(const ConfigSnapshot &snapshot, Listen &host_port, HttpRequest &req_, size_t targetServerIdx, int status, Arena &arena);
     ~Client();
 
     void setupConfig();
+    void destroyResponse();
     void setupResponse();
+    int checkHeaders();
     HttpRequest *getRequest(bool val = false);
     HttpResponse *getResponse();
-    std::string getResponseString();
+    std::string &getResponseString();
+    void setKeepAlive(bool keepAlive);
+    bool shouldDisconnect();
 
 private:
     HttpRequest *request_;
     Listen &host_port_;
     RequestConfig *config_;
     HttpResponse *response_;
-    DB &db_;
+    Arena &arena_; // holds config_ and response_
+    const ConfigSnapshot &snapshot_;
     size_t serverId_;
     int statusCode_;
+    bool keepAlive_;
 };
 
 #endif
\ No newline at end of file
@@ -14,6 +14,7 @@
 # define ConfigDB_H
 
 #include "AllHeaders.hpp"
+#include "ConfigSnapshot.hpp"
 
 class ConfigDB{
 	public:
@@ -34,7 +35,7 @@ class ConfigDB{
 		std::string	readFile(char **argv);
 		std::string	getFullPathKey();
 		std::string getKeyWithoutLastSection();
-		KeyValues getKeyValue();
+		KeyValues getKeyValue() const;
 		void splitDB(const KeyValues& keyValues);
 		void splitDirectiveAndValue(std::string currentSection, VecStr::const_iterator it, std::string trimmedLine);
 		void printChoice(bool allRootData, int rootDataIdx, bool allServersData, int serverDataIdx, bool allConfig);
@@ -42,6 +43,9 @@ class ConfigDB{
 		void handleServerDB(MapStr keyMap, const std::string& key,const VecStr& values, size_t lhs, size_t rhs);
 		GroupedDBMap getServers() const;
 		GroupedDBMap getRootConfig() const;
+		std::string getRootDirective(const std::string &directive, const std::string &block = "") const;
+		std::string getServerDirective(int index, const std::string &directive) const;
+		ConfigSnapshot *acquireSnapshot() const;
 
 		
 	private:
@@ -50,7 +54,12 @@ class ConfigDB{
 		KeyValues _keyValues;
 		GroupedDBMap groupedServers;
 		GroupedDBMap groupedRootData;
+		LocationOrderMap locationOrder;
+		ConfigSnapshot *snapshot_;
 		size_t counter;
+
+		ConfigDB(const ConfigDB &);
+		ConfigDB &operator=(const ConfigDB &);
 };
 
 #endif
@@ -0,0 +1,32 @@
+#ifndef CONFIGSNAPSHOT_HPP
+#define CONFIGSNAPSHOT_HPP
+
+#include "./ServerConfig.hpp"
+
+/**
+ * @brief Compiled server blocks, immutable once built and shared by
+ * reference count.
+ *
+ * ConfigDB builds one when it parses the config, every Servers loop takes
+ * a reference for its lifetime, and the requests it serves borrow that
+ * one without touching the count. The last release frees it.
+ */
+class ConfigSnapshot
+{
+public:
+  ConfigSnapshot(const GroupedDBMap &servers, const GroupedDBMap &root, const LocationOrderMap &order);
+
+  ConfigSnapshot *acquire();
+  void release();
+  const ServerConfig &server(int index) const;
+
+private:
+  ConfigSnapshot(const ConfigSnapshot &);
+  ConfigSnapshot &operator=(const ConfigSnapshot &);
+  ~ConfigSnapshot();
+
+  ServerConfigMap servers_;
+  int references_;
+};
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef CONNECTION_HPP
+#define CONNECTION_HPP
+
+#include "AllHeaders.hpp"
+#include "TimerWheel.hpp"
+#include "Arena.hpp"
+
+class HttpRequest;
+
+#define DEFAULT_KEEPALIVE_TIMEOUT 75
+#define DEFAULT_KEEPALIVE_REQUESTS 1000
+#define DEFAULT_CLIENT_TIMEOUT 60
+#define OUTPUT_IOV_MAX 64 // queued responses handed to one sendmsg
+#define LINGERING_TIMEOUT 5000 // ms a refused client gets to stop sending
+
+/**
+ * @brief State of one accepted client socket inside the event loop.
+ *
+ * Every client fd registered in the epoll set owns one Connection, so the
+ * loop can interleave reads and writes of many clients instead of serving
+ * them one after another.
+ *
+ * Pipelined requests are answered in order: each response is queued as
+ * its own buffer and the whole queue goes out with one gathered write.
+ *
+ * The objects that build a response are placed in the connection's arena,
+ * which is rewound for every new request.
+ */
+class Connection
+{
+public:
+    enum State
+    {
+        READING,
+        WRITING,
+        LINGERING, // response sent, dropping what the client still sends
+        CLOSING
+    };
+
+    // What the connection's timer is waiting for
+    enum Deadline
+    {
+        HEADER_DEADLINE,
+        BODY_DEADLINE,
+        SEND_DEADLINE,
+        KEEPALIVE_DEADLINE,
+        LINGER_DEADLINE
+    };
+
+    Connection(int fd, int server_fd);
+    ~Connection();
+
+    int getFd() const;
+    int getServerFd() const;
+    State getState() const;
+    void setState(State state);
+    HttpRequest &getRequest();
+    Arena &getArena();
+    std::string &getReadBuffer();
+    bool getKeepAlive() const;
+    void setKeepAlive(bool keepAlive);
+    size_t getRequestCount() const;
+    Timer &getTimer();
+    void nextRequest();
+    uint32_t getId() const;
+    void setId(uint32_t id);
+    uint32_t getEvents() const;
+    void setEvents(uint32_t events);
+    bool isSending() const;
+    void setSending(bool sending);
+    bool isReceiving() const;
+    void setReceiving(bool receiving);
+    int release();
+
+    ssize_t fill();
+    void append(const char *data, size_t size);
+    void queueResponse(const std::string &response);
+    void takeResponse(std::string &response);
+    bool hasPendingOutput() const;
+    const struct msghdr *pendingOutput();
+    void consume(size_t bytes);
+    ssize_t flush();
+
+private:
+    Connection(const Connection &other);
+    Connection &operator=(const Connection &other);
+
+    int fd_;
+    int server_fd_;
+    State state_;
+    HttpRequest request_;
+    Arena arena_;
+    std::string read_buffer_;
+    std::deque<std::string> output_; // push_back never moves queued responses
+    size_t output_sent_;              // bytes of output_.front() already sent
+    std::vector<struct iovec> iov_;
+    struct msghdr msg_;
+    bool keep_alive_;
+    size_t requests_;
+    Timer timer_;
+    uint32_t id_;
+    uint32_t events_; // what epoll currently reports for fd_
+    bool sending_; // an io_uring sendmsg still reads msg_ and output_
+    bool receiving_; // a multishot io_uring recv is armed on fd_
+};
+
+#endif
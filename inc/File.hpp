@@ -3,6 +3,7 @@
 
 #include "./AllHeaders.hpp"
 #include "./MimeTypes.hpp"
+#include "./BodyBuffer.hpp"
 
 class MimeTypes;
 
@@ -37,21 +38,21 @@ public:
     void parseExt();
     void parseExtNegotiation();
     void closeFile();
-    void createFile(const std::string &body);
+    void createFile(const BodyBuffer &body);
     void appendFile(const std::string &body);
-    void appendFile(const std::string &body, std::string MimeTypes);
+    void appendFile(const BodyBuffer &body, std::string MimeTypes);
     bool deleteFile();
-    void set_path(std::string path, bool negotiation = false);
+    void set_path(const std::string &path, bool negotiation = false);
     void findMatchingFiles();
     void print_file_info(const std::string& filename) const;
     void print_dir_entry(struct dirent* ent) const;
     
 
     std::string last_modified();
-    std::string find_index(std::vector<std::string> &indexes);
+    std::string find_index(const std::vector<std::string> &indexes);
     std::string listDir(std::string &target);
     std::string &getMimeExt();
-    std::string getContent();
+    bool getContent(std::string &content);
     std::string &getFilePath();
     std::string getMimeType(const std::string ext);
     std::string getStatusCode(int code);
@@ -2,27 +2,75 @@
 #define HTTP_REQUEST_PARSER_HPP
 
 #include "./AllHeaders.hpp"
+#include "./KnownHeaders.hpp"
+#include "./Methods.hpp"
+#include "./BodyBuffer.hpp"
 
+#define REQUEST_LINE_MAX 8192          // longer request lines get 414
+#define REQUEST_HEADERS_MAX 32768      // larger header blocks get 431
+#define REQUEST_HEADERS_COUNT_MAX 100  // more header fields get 431
+#define CHUNK_LINE_MAX 4096            // longer chunk size lines or trailer fields get 400
+
+// parseRequest() results besides HTTP error statuses
+#define REQUEST_INCOMPLETE 0   // waiting for more bytes
+#define REQUEST_COMPLETE 1
+#define REQUEST_HEADERS_DONE 2 // a body follows; vet the headers before reading it
+
+/**
+ * @brief A header value as a slice of the request buffer, empty when the
+ * field is absent. Valid until the request reads more bytes or is reset.
+ */
+struct HeaderValue {
+    const char *data;
+    size_t size;
+
+    bool empty() const { return size == 0; }
+    std::string str() const { return std::string(data, size); }
+    bool operator==(const std::string &other) const { return other.compare(0, std::string::npos, data, size) == 0; }
+};
+
+/**
+ * @brief Incremental HTTP/1.1 request parser.
+ *
+ * Works in place over the bytes the connection received: nothing is erased
+ * while the request line and headers are parsed, a resume offset records
+ * how far parsing got, and header fields are (offset, length) slices of
+ * that buffer with their names lowercased in place. Fields with a HeaderId
+ * get a fixed slot, the rest are kept in arrival order.
+ */
 class HttpRequest {
 private:
-    std::string method_;
+    // One header field, both parts slices of req_buffer_
+    struct Header {
+        size_t name;
+        size_t name_len;
+        size_t value;
+        size_t value_len;
+    };
+
+    HttpMethod method_;
     std::string uri_;
     std::string scheme_;
     std::string authority_;
     std::string path_;
     std::string query_;
     std::string frag_;
-    std::string target_;
     std::string protocol_;
-    std::map<std::string, std::string> headers_;
-    std::string body_;
+    Header known_[HEADER_COUNT]; // name_len 0 while the field is absent
+    std::vector<Header> others_;
+    size_t header_count_;
+    BodyBuffer body_;
     std::string req_buffer_;
+    size_t parse_pos_; // first byte of req_buffer_ not parsed yet
+    size_t scan_pos_;  // where the search for the next CRLF resumes
+    size_t head_end_;  // end of the header block, 0 until it was parsed
     size_t length_;
+    size_t max_body_size_; // 0 for no limit
     size_t chunk_size_;
+    size_t chunk_line_;   // bytes of the chunk size line or trailer field so far
+    size_t trailer_size_; // bytes of all trailer fields so far
     bool isChunked_;
-    int body_offset_;
-    struct timeval start_tv_;
-    struct timeval last_tv_;
+    bool rewritten_; // path_ was replaced by a location return
 
     enum Section {
         REQUEST_LINE,
@@ -33,9 +81,19 @@ private:
         COMPLETE,
         ERROR
     };
+    // Where the chunked decoder is, one state per byte position
     enum ChunkStatus {
+        CHUNK_SIZE,          // hex digits
+        CHUNK_EXTENSION,     // rest of the size line, ignored
+        CHUNK_SIZE_LF,
         CHUNK_BODY,
-        CHUNK_SIZE
+        CHUNK_DATA_CR,       // the CRLF closing a chunk's data
+        CHUNK_DATA_LF,
+        CHUNK_TRAILER,       // start of a trailer field or of the final CRLF
+        CHUNK_TRAILER_NAME,
+        CHUNK_TRAILER_VALUE,
+        CHUNK_TRAILER_LF,
+        CHUNK_END_LF
     };
 
     Section buffer_section_;
@@ -44,29 +102,25 @@ private:
     int extractURIComponents();
     bool isValidScheme(const std::string& scheme);
     int isValidAuthority(const std::string& authority);
-    bool isValidPath(const std::string& path);
-    bool isValidQuery(const std::string& query);
-    bool isValidFragment(const std::string& fragment);
     void print_uri_extracts();
     bool isValidIPv6(const std::string& ipv6);
     int isValidProtocol(const std::string& protocol);
-    void parseContentLength();
     int parseMethod();
     int validateURI();
-    int extractRequestLineData(std::string requestLine);
-    std::string trimmer(const std::string& str);
-    bool isValidHeaderChar(unsigned char c);
-    bool isValidHeaderFormat(const std::string& header);
+    int extractRequestLineData(size_t start, size_t end);
+    size_t findLineEnd();
+    const Header *findHeader(HeaderId id) const;
+    const Header *findHeader(const char *name, size_t len) const;
+    std::string headerValue(const Header &header) const;
+    bool headerEquals(const Header &header, const char *value) const;
     int parseHeaders();
     int parseRequestLine();
     int parseBody();
-    int parseChunkTrailer();
     int parseChunkedBody();
-    int parseChunkSize(const std::string& hex);
+    int chunkSizeLineDone();
     int checkSpecialHeaders();
-    void extractPathQueryFragment(size_t pathStart);
+    int extractPathQueryFragment(size_t pathStart);
     void parseSchemeAndAuthority(size_t schemeEnd, size_t& pathStart);
-    std::string decodeURIComponent(const std::string& str);
     std::string uri_suffix_;
 
 
@@ -75,27 +129,39 @@ public:
     ~HttpRequest();
 
     int parseRequest(std::string &buffer);
+    void reset();
+    void takeUnparsed(std::string &buffer);
+    bool keepAlive();
+    bool hasStarted() const;
+    bool inBody() const;
+    bool isComplete() const;
+    bool expectsContinue() const;
 
-    std::string &getMethod();
+    HttpMethod getMethod() const;
+    void setMethod(HttpMethod method);
     std::string &getURI();
     std::string &getPath();
     std::string &getQuery();
     std::string &getFragment();
     std::string &getProtocol();
-    const std::string &getBody() const;
-    std::string &getHeader(std::string key);
+    const BodyBuffer &getBody() const;
+    void setBodyBuffer(size_t memory_max, const std::string &temp_path);
+    bool hasHeader(HeaderId id) const;
+    HeaderValue getHeader(HeaderId id) const;
+    HeaderValue getHeader(const std::string &key) const;
+    std::string getHost() const;
     std::map<std::string, std::string> getHeaders() const;
-    std::string getTarget() const;
+    const std::string &getTarget() const;
     size_t getContentLength();
+    void setMaxBodySize(size_t size);
     std::string getUriSuffix();
     void setUriSuffix(std::string& uri);
 
-    void setTarget(std::string target);
-    void printRequest(HttpRequest parser);
+    void setTarget(const std::string &target);
+    bool isRewritten() const;
+    void printRequest(HttpRequest &parser);
 
     bool timeout();
-    time_t get_start_timer_in_sec();
-    time_t get_last_timer_in_sec();
     
     int getStatus();
 };
@@ -3,13 +3,13 @@
 
 #include "./AllHeaders.hpp"
 #include "./File.hpp"
+#include "./Methods.hpp"
+#include "./Arena.hpp"
 
 class HttpRequest;
 class RequestConfig;
 class File;
 
-extern pthread_mutex_t g_write;
-
 struct CharsetAndQ {
     std::string charset;
     double qValue;
@@ -17,11 +17,10 @@ struct CharsetAndQ {
 
 class HttpResponse {
 public:
-    HttpResponse(RequestConfig &config, int error_code = 100);
+    HttpResponse(RequestConfig &config, Arena &arena, int error_code = 100);
     ~HttpResponse();
 
     typedef int (HttpResponse::*type)();
-    void initMethods();
 
     enum LogLevel {
         NONE,
@@ -46,8 +45,9 @@ public:
     bool localization(std::vector<std::string> &matches);
     std::string accept_charset(std::vector<std::string> &matches);
     bool getRedirect();
-    std::string redirect_target();
+    const std::string &redirect_target();
     bool shouldDisconnect();
+    void setKeepAlive(bool keepAlive);
     void printMethodMap();
     void setErrorPageHeaders(int status_code);
     int checkCustomErrorPage(int status_code);
@@ -58,7 +58,7 @@ public:
     CharsetAndQ extractCharsetAndQ(const std::string& charsetAndQ);
     std::string handleDefaultCharset(const std::string& bestCharset);
     std::string findBestCharset(const std::vector<CharsetAndQ>& charsetAndQValues, const std::vector<std::string>& matches);
-    void buildDebugger (std::string method);
+    void buildDebugger (HttpMethod method);
 
     std::string response_log(LogLevel level);
 
@@ -69,13 +69,12 @@ public:
 
     int getStatus();
     std::string getResponseBody();
-    int sendResponse(int fd);
-    std::string getSampleResponse();
+    std::string &getSampleResponse();
     bool isCgi(std::string extension);
 
     void HandleCgi();
     void setCgiPipe(CgiHandle &cgi);
-    void toCgi(CgiHandle &cgi, std::string &req_body);
+    void toCgi(CgiHandle &cgi);
     void fromCgi(CgiHandle &cgi);
     void handleCgiHeaders(std::string &body);
     void parseCgiHeaders();
@@ -85,28 +84,26 @@ public:
 
 private:
     RequestConfig &config_;
+    Arena &arena_; // holds file_ and the nodes of headers_
     File *file_;
     int error_code_;
     int worker_id_;
-    size_t total_sent_;
     int status_code_;
     std::string response_;
     std::string body_;
     bool redirect_;
+    bool keep_alive_;
     std::string redirect_target_;
     int redirect_code_;
     size_t header_size_;
     size_t body_size_;
     std::string charset_;
-    std::map<std::string, HttpResponse::type> methods_;
-    std::pair<std::string, int> findLocation(std::string target);
-    std::map<std::string, std::string> headers_;
+    ArenaMap<std::string, std::string>::type headers_;
 
     std::string cgiHeaders_;
     bool cgiHeadersParsed_;
     bool cgiRead;
-    std::string buildMethodList();
-    bool checkAuth();
+    const std::string &buildMethodList();
 };
 
 std::string getMimeType(const std::string& ext);
@@ -0,0 +1,53 @@
+#ifndef KNOWN_HEADERS_HPP
+#define KNOWN_HEADERS_HPP
+
+#include <cstddef>
+
+// Header fields the server looks up by id instead of by name
+enum HeaderId
+{
+    HEADER_HOST,
+    HEADER_CONTENT_LENGTH,
+    HEADER_CONTENT_TYPE,
+    HEADER_TRANSFER_ENCODING,
+    HEADER_CONNECTION,
+    HEADER_ACCEPT,
+    HEADER_ACCEPT_CHARSET,
+    HEADER_ACCEPT_ENCODING,
+    HEADER_ACCEPT_LANGUAGE,
+    HEADER_AUTHORIZATION,
+    HEADER_COOKIE,
+    HEADER_USER_AGENT,
+    HEADER_REFERER,
+    HEADER_EXPECT,
+    HEADER_IF_MODIFIED_SINCE,
+    HEADER_IF_NONE_MATCH,
+    HEADER_RANGE,
+    HEADER_KEEP_ALIVE,
+    HEADER_TE,
+    HEADER_TRAILER,
+    HEADER_UPGRADE,
+    HEADER_CACHE_CONTROL,
+    HEADER_ORIGIN,
+    HEADER_X_FORWARDED_FOR,
+    HEADER_COUNT,
+    HEADER_OTHER = HEADER_COUNT // any name not listed above
+};
+
+/**
+ * @brief Maps lowercase header names to a HeaderId with a perfect hash.
+ *
+ * A lookup hashes the length and the first and last bytes, then confirms
+ * the one candidate with a single compare. Nothing is allocated.
+ */
+class KnownHeaders
+{
+public:
+    static HeaderId lookup(const char *name, size_t len);
+    static const char *name(HeaderId id);
+
+private:
+    KnownHeaders();
+};
+
+#endif
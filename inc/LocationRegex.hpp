@@ -0,0 +1,40 @@
+#ifndef LOCATIONREGEX_HPP
+#define LOCATIONREGEX_HPP
+
+#include <regex.h>
+#include <string>
+
+/**
+ * @brief A ~ or ~* location compiled once when the config is loaded.
+ *
+ * The literal bytes a match has to start with, end with or contain are
+ * taken from the pattern as well, so most targets are turned down by a
+ * compare before regexec runs.
+ */
+class LocationRegex
+{
+public:
+  LocationRegex();
+  LocationRegex(const LocationRegex &other);
+  LocationRegex &operator=(const LocationRegex &other);
+  ~LocationRegex();
+
+  bool compile(const std::string &pattern, bool caseless, int location);
+  bool matches(const std::string &target) const;
+  int location() const;
+
+private:
+  void clear();
+  void extractLiterals();
+
+  std::string pattern_;
+  bool caseless_;
+  int location_; // index in ServerConfig::locations
+  bool compiled_;
+  regex_t regex_;
+  std::string prefix_; // when the pattern starts with ^
+  std::string suffix_; // when it ends with $
+  std::string infix_;  // longest other literal run
+};
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef LOCATIONTREE_HPP
+#define LOCATIONTREE_HPP
+
+#include <string>
+#include <vector>
+
+/**
+ * @brief Byte-wise radix tree over the prefix and exact locations of a
+ * server, so a lookup walks the target once whatever their number.
+ *
+ * Each node stores the index of the prefix location (plain or ^~) and of
+ * the = location whose path ends there, -1 for none.
+ */
+class LocationTree
+{
+public:
+  LocationTree();
+
+  bool insert(const std::string &path, int location, bool exact);
+  int match(const std::string &target, bool &exact) const;
+  int find(const std::string &path) const;
+  size_t size() const;
+
+private:
+  struct Node
+  {
+    Node(const std::string &label);
+
+    std::string label; // bytes on the edge from the parent
+    std::string first; // first byte of each child's label, sorted
+    std::vector<int> children;
+    int prefix;
+    int exact;
+  };
+
+  int child(int node, char byte) const;
+  int addChild(int node, const std::string &label);
+  int descend(const std::string &path) const;
+
+  std::vector<Node> nodes_;
+};
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef METHODS_HPP
+#define METHODS_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Request methods the parser recognizes, anything else is answered with 501
+enum HttpMethod
+{
+    METHOD_GET,
+    METHOD_HEAD,
+    METHOD_POST,
+    METHOD_PUT,
+    METHOD_DELETE,
+    METHOD_PATCH,
+    METHOD_OPTIONS,
+    METHOD_TRACE,
+    METHOD_CONNECT,
+    METHOD_COUNT,
+    METHOD_UNKNOWN = METHOD_COUNT
+};
+
+// Set of methods, bit m for HttpMethod m
+typedef unsigned int MethodMask;
+
+#define METHOD_BIT(method) (1u << (method))
+#define METHODS_ALL (METHOD_BIT(METHOD_COUNT) - 1)
+// Methods HttpResponse has a handler for, the default of a location
+#define METHODS_IMPLEMENTED (METHOD_BIT(METHOD_GET) | METHOD_BIT(METHOD_HEAD) | METHOD_BIT(METHOD_POST) | METHOD_BIT(METHOD_PUT) | METHOD_BIT(METHOD_DELETE))
+
+/**
+ * @brief Method tokens as an enum and method lists as a bitmask.
+ *
+ * The parser turns the request method into a HttpMethod once, locations
+ * turn allow_methods / limit_except into a MethodMask, and the Allow value
+ * of every possible mask is built once on first use.
+ */
+class Methods
+{
+public:
+    static HttpMethod lookup(const char *token, size_t len);
+    static const char *name(HttpMethod method);
+    static MethodMask compile(const std::vector<std::string> &names);
+    static const std::string &allowHeader(MethodMask mask);
+
+private:
+    Methods();
+};
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef PATHLOCK_HPP
+#define PATHLOCK_HPP
+
+#include "./AllHeaders.hpp"
+
+#define PATH_LOCK_STRIPES 64
+
+/**
+ * @brief Scoped lock serializing writers of the same path.
+ *
+ * Paths hash onto a fixed set of read-write locks, so requests touching
+ * different files never wait on each other. Readers share a lock and only
+ * wait for a writer, so a GET never sees a file halfway through a PUT.
+ * The locks only order the threads of one process.
+ */
+class PathLock
+{
+public:
+    enum Mode
+    {
+        READ,
+        WRITE
+    };
+
+    explicit PathLock(const std::string &path, Mode mode = WRITE);
+    ~PathLock();
+
+private:
+    PathLock(const PathLock &other);
+    PathLock &operator=(const PathLock &other);
+
+    static void initLocks();
+
+    static pthread_rwlock_t locks_[PATH_LOCK_STRIPES];
+    static pthread_once_t once_;
+    pthread_rwlock_t *lock_;
+};
+
+#endif
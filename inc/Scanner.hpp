@@ -0,0 +1,34 @@
+#ifndef SCANNER_HPP
+#define SCANNER_HPP
+
+#include <cstddef>
+
+/**
+ * @brief Delimiter scanning for the request parser.
+ *
+ * Looks at 16 (SSE2) or 32 (AVX2) bytes per step. The widest version the
+ * CPU supports is picked once at startup, other architectures get the
+ * scalar loops.
+ */
+class Scanner
+{
+public:
+    enum Level
+    {
+        SCALAR,
+        SSE2,
+        AVX2
+    };
+
+    static size_t lineEnd(const char *data, size_t len);
+    static size_t headerName(char *data, size_t len);
+
+    static Level level();
+    static bool setLevel(Level level);
+    static const char *levelName(Level level);
+
+private:
+    Scanner();
+};
+
+#endif
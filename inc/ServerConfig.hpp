@@ -0,0 +1,76 @@
+#ifndef SERVERCONFIG_HPP
+#define SERVERCONFIG_HPP
+
+#include "./LocationRegex.hpp"
+#include "./LocationTree.hpp"
+#include "./Methods.hpp"
+#include <map>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#define DEFAULT_ROOT "html"
+#define DEFAULT_CLIENT_MAX_BODY_SIZE 20971520
+#define DEFAULT_CGI_TIMEOUT 60
+
+typedef std::map<std::string, std::string> MapStr;
+typedef std::vector<std::string> VecStr;
+typedef std::pair<MapStr, VecStr> KeyMapValue;
+typedef std::map<int, std::vector<KeyMapValue> > GroupedDBMap;
+typedef std::map<int, VecStr> LocationOrderMap; // per server, as written
+
+enum LocationModifier
+{
+  NONE,
+  EXACT,
+  CASE_SENSITIVE,
+  CASE_INSENSITIVE,
+  LONGEST,
+};
+
+/**
+ * @brief Settings of one location with every directive already resolved,
+ * location over server over http.
+ */
+struct LocationConfig
+{
+  LocationConfig();
+
+  bool isRegex() const;
+
+  std::string path; // without the modifier, empty for the server level
+  LocationModifier modifier;
+  std::string root;
+  size_t client_max_body_size;
+  bool autoindex;
+  VecStr indexes;
+  std::map<int, std::string> error_pages;
+  std::map<int, std::string> redirects;
+  MethodMask methods;
+  std::string auth;
+  std::string upload;
+  VecStr cgi;
+  std::string cgi_bin;
+  uint64_t cgi_timeout;
+};
+
+/**
+ * @brief One server block of ConfigDB, compiled when the config is loaded
+ * so a request only has to pick its location.
+ */
+struct ServerConfig
+{
+  void compile(const std::vector<KeyMapValue> &server, const GroupedDBMap &root, const VecStr &order);
+  const LocationConfig &match(const std::string &target) const;
+  const LocationConfig *find(const std::string &path) const;
+
+  VecStr names; // server_name
+  LocationConfig defaults; // for requests no location matches
+  std::vector<LocationConfig> locations; // in config order
+  LocationTree prefixes; // prefix, ^~ and = locations, by index in locations
+  std::vector<LocationRegex> regexes; // ~ and ~* locations, in config order
+};
+
+typedef std::map<int, ServerConfig> ServerConfigMap;
+
+#endif
@@ -13,29 +13,87 @@
 #ifndef SERVERS_HPP
 # define SERVERS_HPP
 #include "AllHeaders.hpp"
+#include "VirtualHosts.hpp"
 
 class ConfigDB;
 class InputArgs;
-struct DB;
+class ConfigSnapshot;
 struct Listen;
 class HttpRequest;
+class Connection;
+class TimerWheel;
+class Uring;
+struct UringCompletion;
+
+#define DEFAULT_EPOLL_EVENTS 512
+#define ACCEPT_STATS_INTERVAL 10
+#define ACCEPT_PAUSE_MS 100 // out of file descriptors: retry accepting after this
+#define URING_READ_AHEAD 65536 // input buffered while a response is written before the io_uring recv stops
+
+// Deadlines of a server block, in milliseconds
+struct ServerTimeouts
+{
+	uint64_t keepalive;
+	uint64_t header;
+	uint64_t body;
+	uint64_t send;
+};
+
+// Request body buffering of a server block
+struct ServerBodyBuffer
+{
+	size_t size;           // bodies up to this size stay in memory
+	std::string temp_path; // larger ones are spilled to a file in here
+};
+
+#ifndef EPOLLEXCLUSIVE
+# define EPOLLEXCLUSIVE (1u << 28)
+#endif
 
 class Servers {
 	private:
 		std::vector<int> _server_fds;
 		int _epoll_fds;
-		std::map<int, std::vector<std::string> > _domain_to_server;
+		std::map<int, VirtualHosts> _virtual_hosts; // per listener fd, by server_name
 		std::map<int, std::string> _ip_to_server;
 		std::map<std::string, std::vector<std::string> > _keyValues;
 		std::map<int, std::vector<std::string> > server_index;
 		std::map<int, int> server_fd_to_index;
+		std::map<int, Connection *> _connections;
+		std::map<uint32_t, Connection *> _closing; // io_uring clients by id, until their last recv and send completed
+		int _max_events;
+		std::map<int, ServerTimeouts> _timeouts;
+		std::map<int, size_t> _keepalive_requests;
+		std::map<int, ServerBodyBuffer> _body_buffers;
+		time_t _last_sweep;
+		std::map<std::string, int> _listen_backlog;
+		bool _shared_listeners;
+		std::map<std::string, size_t> _listen_max_connections;
+		std::map<int, size_t> _max_connections; // per listener fd, from max_connections=
+		std::map<int, size_t> _listener_connections;
+		size_t _worker_connections; // per event loop, 0 for no limit
+		std::vector<int> _paused_listeners;
+		uint64_t _accept_paused_until;
+		// accept statistics, logged every ACCEPT_STATS_INTERVAL seconds
+		unsigned long _accept_wakeups;
+		unsigned long _accepted;
+		unsigned long _accept_batch_max;
+		unsigned long _listen_overflows; // host-wide counter at the last log line
+		unsigned long _shed;
+		unsigned long _accept_pauses;
+		time_t _last_stats;
+		TimerWheel *_timers;
+		uint64_t _now; // monotonic ms, read once per loop iteration
+		Uring *_uring; // events { use io_uring; }, NULL for epoll
+		uint32_t _next_id;
 	public:
 		
 		//Constructors
-		Servers(ConfigDB &configDB);
+		Servers(const ConfigDB &configDB);
 		~Servers();
 
-		ConfigDB &configDB_;
+		const ConfigDB &configDB_;
+		ConfigSnapshot *snapshot_; // shared by every request of this loop
 
 		//Member functions
 		int		checkSocket(std::string port);
@@ -43,21 +101,58 @@ class Servers {
 		int		createSocket();
 		// void	bindSocket(int port);
 		int		bindSocket(std::string port);
-		int		listenSocket();
+		int		listenSocket(int backlog);
 		int		combineFds();
-		void	createEpoll();
+		int		watchListener(int server_fd);
+		int		createEpoll();
 		void	createServers();
-		void	assignDomain(std::string port, int server_fd);
-		void	assignLocalDomain(int server_fd);
+		void	indexServerNames(const std::string &port, int server_fd);
+		int		serverFor(Connection &conn);
 		void	initEvents();
+		void	runEpoll();
+		void	runUring();
+		void	afterEvents();
+		void	setBackend();
+		void	setMaxEvents();
+		void	setWorkerConnections();
+		void	setTimeouts(int server_idx);
+		void	setBodyBuffer(int server_idx);
+		void	setDeadline(Connection &conn, int type);
+		void	handleTimeout(Connection &conn);
+		void	expireTimers();
+		void	logAcceptStats(time_t now);
+		int		waitTimeout();
+		void	pauseAccepting();
+		void	resumeAccepting();
+		bool	overloaded(int server_fd);
+		void	rejectConnection(Connection &conn);
+		bool	isServerFd(int fd);
+		bool	failed() const;
 		std::vector<std::string> getPorts();
 		std::map<std::string, std::vector<std::string> > getKeyValue() const;
-		bool getRequest(int client_fd, std::string &request);
+		bool getRequest(Connection &conn);
 
-		//Temporal function until we have a completed config file
 		void handleIncomingConnection(int server_fd);
+		void handleConnectionEvent(int fd, uint32_t events);
+		void handleRead(Connection &conn);
+		void handleWrite(Connection &conn);
+		void processRequest(Connection &conn);
+		int checkHeaders(Connection &conn);
+		void sendInterim(Connection &conn, const std::string &response);
+		void lingeringClose(Connection &conn);
+		void drainLingering(Connection &conn);
+		void setReadDeadline(Connection &conn);
+		void startRead(Connection &conn);
+		void armRecv(Connection &conn);
+		void startWrite(Connection &conn);
+		void writeProgress(Connection &conn);
+		void addConnection(int fd, int server_fd);
+		void handleCompletion(const UringCompletion &completion);
+		Connection *findConnection(uint64_t user_data);
+		bool watchConnection(Connection &conn, uint32_t events, int op);
+		void closeConnection(Connection &conn);
 		void printServerAddress(int server_fd);
-		size_t handleResponse(int reqStatus, int server_fd, int new_socket, HttpRequest &parser);
+		void handleResponse(int reqStatus, Connection &conn);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,55 @@
+#ifndef TIMERWHEEL_HPP
+#define TIMERWHEEL_HPP
+
+#include "AllHeaders.hpp"
+
+#define TIMER_TICK_MS 100
+#define TIMER_SLOT_BITS 6
+#define TIMER_SLOTS (1 << TIMER_SLOT_BITS)
+#define TIMER_LEVELS 4
+
+/**
+ * @brief Intrusive timer node, embedded in the object it times out.
+ */
+struct Timer
+{
+    Timer *prev;
+    Timer *next;
+    uint64_t expires; // in ticks
+    int type;
+    void *data;
+
+    Timer();
+    bool active() const;
+};
+
+/**
+ * @brief Hierarchical timing wheel of the event loop.
+ *
+ * Four levels of 64 slots cover 100 ms ticks up to ~19 days. Adding and
+ * removing a timer is O(1); a timer is cascaded to a finer level at most
+ * once per level before it fires, so expiring is O(1) amortised as well.
+ */
+class TimerWheel
+{
+public:
+    TimerWheel(uint64_t now_ms);
+    ~TimerWheel();
+
+    void add(Timer &timer, uint64_t expires_ms);
+    void remove(Timer &timer);
+    void expire(uint64_t now_ms, std::vector<Timer *> &expired);
+    int nextTimeout(uint64_t now_ms, int max_ms) const;
+
+private:
+    TimerWheel(const TimerWheel &other);
+    TimerWheel &operator=(const TimerWheel &other);
+
+    void insert(Timer &timer);
+    void cascade(int level, size_t slot);
+
+    Timer slots_[TIMER_LEVELS][TIMER_SLOTS];
+    uint64_t current_; // next tick to process
+};
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef URING_HPP
+#define URING_HPP
+
+#include "AllHeaders.hpp"
+
+#define URING_ENTRIES 1024
+#define URING_BUFFERS 512 // power of two
+#define URING_BUFFER_SIZE 4096
+#define URING_BUFFER_GROUP 0
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+struct io_uring_buf_ring;
+
+// One completion copied out of the completion ring
+struct UringCompletion
+{
+    uint64_t user_data;
+    int32_t res;
+    uint32_t flags;
+};
+
+/**
+ * @brief io_uring instance of one event loop, driven through the raw syscalls.
+ *
+ * Accept and recv are multishot: they stay armed and keep producing
+ * completions, recv picking its buffer from a provided buffer ring. Requests
+ * are only queued here; wait() submits them together with waiting for
+ * completions, so a loop iteration costs a single io_uring_enter.
+ *
+ * Builds without HAVE_IO_URING keep the class but setup() always fails.
+ */
+class Uring
+{
+public:
+    Uring();
+    ~Uring();
+
+    bool setup(unsigned entries = URING_ENTRIES);
+
+    void accept(int fd, uint64_t user_data);
+    void recv(int fd, uint64_t user_data);
+    void sendmsg(int fd, const struct msghdr *msg, uint64_t user_data);
+    void cancel(uint64_t target, uint64_t user_data);
+    void cancelAndClose(int fd, uint64_t user_data);
+
+    int wait(int timeout_ms);
+    void reap(std::vector<UringCompletion> &completions);
+
+    bool hasMore(const UringCompletion &completion) const;
+    bool hasBuffer(const UringCompletion &completion) const;
+    const char *buffer(const UringCompletion &completion) const;
+    void recycle(const UringCompletion &completion);
+
+private:
+    Uring(const Uring &other);
+    Uring &operator=(const Uring &other);
+
+    struct io_uring_sqe *nextSqe();
+    int enter(unsigned to_submit, unsigned min_complete, unsigned flags, const void *arg, size_t arg_size);
+    bool setupBuffers();
+
+    int fd_;
+    void *sq_ring_;
+    size_t sq_ring_size_;
+    void *cq_ring_;
+    size_t cq_ring_size_;
+    struct io_uring_sqe *sqes_;
+    size_t sqes_size_;
+
+    unsigned *sq_head_;
+    unsigned *sq_tail_;
+    unsigned *sq_array_;
+    unsigned sq_mask_;
+    unsigned sq_entries_;
+    unsigned sqe_tail_; // queued but not yet published
+    unsigned *cq_head_;
+    unsigned *cq_tail_;
+    unsigned cq_mask_;
+    struct io_uring_cqe *cqes_;
+
+    struct io_uring_buf_ring *buf_ring_;
+    size_t buf_ring_size_;
+    char *buffers_;
+    unsigned short buf_tail_;
+};
+
+#endif
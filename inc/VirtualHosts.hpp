@@ -0,0 +1,55 @@
+#ifndef VIRTUALHOSTS_HPP
+#define VIRTUALHOSTS_HPP
+
+#include <string>
+#include <vector>
+
+/**
+ * @brief server_name index of one listener, from a Host value to the
+ * server block serving it.
+ *
+ * Exact names, *.example.com and www.example.* each get a hash table, so
+ * a lookup costs one probe per table and dot in the host, whatever the
+ * number of names. Order as in nginx: the exact name, then the longest
+ * leading wildcard, then the longest trailing one. ".example.com" stands
+ * for both "example.com" and "*.example.com".
+ */
+class VirtualHosts
+{
+public:
+  bool add(const std::string &name, int server);
+  int find(const std::string &host) const;
+  size_t size() const;
+
+private:
+  // Open addressing with linear probing, names in lowercase
+  class Table
+  {
+  public:
+    Table();
+
+    bool insert(const std::string &name, int server);
+    int find(const char *name, size_t len) const;
+    size_t size() const;
+
+  private:
+    struct Slot
+    {
+      Slot();
+
+      std::string name;
+      int server; // -1 for an empty slot
+    };
+
+    void grow();
+
+    std::vector<Slot> slots_; // a power of two, at most half full
+    size_t used_;
+  };
+
+  Table exact_;
+  Table leading_;  // "*.example.com" as "example.com"
+  Table trailing_; // "www.example.*" as "www.example"
+};
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef WORKERS_HPP
+#define WORKERS_HPP
+
+#include "AllHeaders.hpp"
+
+class ConfigDB;
+
+/**
+ * @brief Master process of the worker_processes model.
+ *
+ * The configuration is parsed once before the master forks; every worker
+ * then runs its own Servers event loop on SO_REUSEPORT listeners, and the
+ * master respawns workers that crash. With worker_threads a process runs
+ * one such loop per thread instead, all reading the same ConfigDB.
+ */
+class Workers
+{
+public:
+    Workers(const ConfigDB &configDB);
+    ~Workers();
+
+    static int countFromConfig(const ConfigDB &configDB);
+    static int threadsFromConfig(const ConfigDB &configDB);
+    static void setFileLimit(const ConfigDB &configDB);
+    static int serve(const ConfigDB &configDB);
+
+    void run();
+
+private:
+    Workers(const Workers &other);
+    Workers &operator=(const Workers &other);
+
+    pid_t spawn(size_t slot);
+    void reap(pid_t pid, int status);
+    int respawnDue();
+    void waitSignal(int timeout_sec);
+    bool running() const;
+    void shutdown();
+
+    const ConfigDB &configDB_;
+    size_t count_;
+    std::vector<pid_t> pids_;
+    std::vector<time_t> started_;
+    std::vector<time_t> respawn_at_; // when a worker that crashed on startup is forked again, 0 for none
+    sigset_t signals_;               // SIGCHLD and the stop signals, blocked in the master
+    bool stop_;
+};
+
+#endif
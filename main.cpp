@@ -1,6 +1,5 @@
 #include "./inc/Test.hpp"
 
 int main(int argc, char **argv) {
-    serverMain(argc, argv);
-    return (0);
+    return (serverMain(argc, argv));
 }
\ No newline at end of file
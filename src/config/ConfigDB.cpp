@@ -12,12 +12,16 @@
 
 #include "../../inc/ConfigDB.hpp"
 
-ConfigDB::ConfigDB()
+ConfigDB::ConfigDB() : snapshot_(NULL)
 {
     counter = 0;
 }
 
-ConfigDB::~ConfigDB() {}
+ConfigDB::~ConfigDB()
+{
+    if (snapshot_)
+        snapshot_->release();
+}
 
 void ConfigDB::pushInBase(std::string env_name)
 {
@@ -119,6 +123,8 @@ std::string ConfigDB::handleKeySection(int &start, int &end, std::string &line)
             server = true;
         it++;
     }
+    if (server && currentSection.compare(0, 9, "location_") == 0)
+        locationOrder[sectionCounts["server"]].push_back(currentSection.substr(9));
     if (sectionCounts[currentSection] >= 0)
     {
         std::stringstream ss;
@@ -224,9 +230,10 @@ void ConfigDB::execParser(char *argv[])
         }
     }
     splitDB(_keyValues);
+    snapshot_ = new ConfigSnapshot(groupedServers, groupedRootData, locationOrder);
 }
 
-ConfigDB::KeyValues ConfigDB::getKeyValue()
+ConfigDB::KeyValues ConfigDB::getKeyValue() const
 {
     return this->_keyValues;
 }
@@ -253,11 +260,7 @@ void ConfigDB::handleServerDB(MapStr keyMap, const std::string &key, const VecSt
                                : key.substr(0, key.length() - 3);
     size_t locationStart = key.find("location_");
     if (locationStart != std::string::npos)
-    {
-        size_t locationEnd = key.find("[");
-        if (locationEnd != std::string::npos)
-            keyMap["location"] = key.substr(locationStart + 9, locationEnd - locationStart - 9);
-    }
+        keyMap["location"] = key.substr(locationStart + 9, lhs - locationStart - 9);
     groupedServers[index].push_back(std::make_pair(keyMap, values));
 }
 
@@ -268,8 +271,9 @@ void ConfigDB::splitDB(const KeyValues &keyValues)
     {
         const std::string &key = it->first;
         const VecStr &values = it->second;
-        size_t lhs = key.find("[");
-        size_t rhs = key.find("].");
+        // the last "[n]." ends the section, a location regex may hold '['
+        size_t rhs = key.rfind("].");
+        size_t lhs = key.rfind('[', rhs);
         MapStr keyMap;
 
         keyMap["directives"] = key;
@@ -343,3 +347,56 @@ ConfigDB::GroupedDBMap ConfigDB::getRootConfig() const
 {
     return groupedRootData;
 }
+
+// Server blocks with their locations resolved, built once by execParser.
+// The caller owns a reference and releases it when done.
+ConfigSnapshot *ConfigDB::acquireSnapshot() const
+{
+    return snapshot_->acquire();
+}
+
+// First value of a directive outside the server blocks, e.g. ("worker_connections", "events")
+std::string ConfigDB::getRootDirective(const std::string &directive, const std::string &block) const
+{
+    for (GroupedDBMap::const_iterator it = groupedRootData.begin(); it != groupedRootData.end(); ++it)
+    {
+        for (size_t i = 0; i < it->second.size(); ++i)
+        {
+            const MapStr &keyMap = it->second[i].first;
+            if (keyMap.find("directives")->second != directive || keyMap.find("location")->second != block)
+                continue;
+            const VecStr &values = it->second[i].second;
+            for (size_t j = 0; j < values.size(); ++j)
+            {
+                std::string value = trim(values[j]);
+                if (!value.empty())
+                    return value;
+            }
+        }
+    }
+    return "";
+}
+
+// First value of a server-level directive, inherited from the http block when unset
+std::string ConfigDB::getServerDirective(int index, const std::string &directive) const
+{
+    GroupedDBMap::const_iterator it = groupedServers.find(index);
+    if (it != groupedServers.end())
+    {
+        for (size_t i = 0; i < it->second.size(); ++i)
+        {
+            const MapStr &keyMap = it->second[i].first;
+            if (keyMap.find("directives")->second != directive || !keyMap.find("location")->second.empty())
+                continue;
+            const VecStr &values = it->second[i].second;
+            for (size_t j = 0; j < values.size(); ++j)
+            {
+                std::string value = trim(values[j]);
+                if (!value.empty())
+                    return value;
+            }
+        }
+    }
+    std::string value = getRootDirective(directive, "http");
+    return value.empty() ? getRootDirective(directive) : value;
+}
@@ -0,0 +1,36 @@
+#include "../../inc/ConfigSnapshot.hpp"
+
+ConfigSnapshot::ConfigSnapshot(const GroupedDBMap &servers, const GroupedDBMap &root, const LocationOrderMap &order) : references_(1)
+{
+    static const VecStr none;
+    for (GroupedDBMap::const_iterator it = servers.begin(); it != servers.end(); ++it)
+    {
+        LocationOrderMap::const_iterator locations = order.find(it->first);
+        servers_[it->first].compile(it->second, root, locations == order.end() ? none : locations->second);
+    }
+}
+
+ConfigSnapshot::~ConfigSnapshot()
+{
+}
+
+// Worker threads take and drop their references concurrently
+ConfigSnapshot *ConfigSnapshot::acquire()
+{
+    __atomic_add_fetch(&references_, 1, __ATOMIC_RELAXED);
+    return this;
+}
+
+void ConfigSnapshot::release()
+{
+    if (__atomic_sub_fetch(&references_, 1, __ATOMIC_ACQ_REL) == 0)
+        delete this;
+}
+
+// Server block by ConfigDB index, an empty one with the defaults if missing
+const ServerConfig &ConfigSnapshot::server(int index) const
+{
+    static const ServerConfig none = ServerConfig();
+    ServerConfigMap::const_iterator it = servers_.find(index);
+    return it == servers_.end() ? none : it->second;
+}
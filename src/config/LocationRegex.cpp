@@ -0,0 +1,197 @@
+#include "../../inc/LocationRegex.hpp"
+#include <cctype>
+#include <cstring>
+#include <vector>
+
+LocationRegex::LocationRegex() : caseless_(false), location_(-1), compiled_(false)
+{
+}
+
+// regex_t can not be copied, the copy compiles the pattern again
+LocationRegex::LocationRegex(const LocationRegex &other) : caseless_(false), location_(-1), compiled_(false)
+{
+    if (other.compiled_)
+        compile(other.pattern_, other.caseless_, other.location_);
+}
+
+LocationRegex &LocationRegex::operator=(const LocationRegex &other)
+{
+    if (this != &other)
+    {
+        clear();
+        if (other.compiled_)
+            compile(other.pattern_, other.caseless_, other.location_);
+    }
+    return *this;
+}
+
+LocationRegex::~LocationRegex()
+{
+    clear();
+}
+
+void LocationRegex::clear()
+{
+    if (compiled_)
+        regfree(&regex_);
+    compiled_ = false;
+    prefix_.clear();
+    suffix_.clear();
+    infix_.clear();
+}
+
+// POSIX extended syntax, ~* adds REG_ICASE. False if the pattern is invalid.
+bool LocationRegex::compile(const std::string &pattern, bool caseless, int location)
+{
+    clear();
+    pattern_ = pattern;
+    caseless_ = caseless;
+    location_ = location;
+    if (regcomp(&regex_, pattern.c_str(), REG_EXTENDED | REG_NOSUB | (caseless ? REG_ICASE : 0)) != 0)
+        return false;
+    compiled_ = true;
+    extractLiterals();
+    return true;
+}
+
+static bool isEscaped(const std::string &pattern, size_t pos)
+{
+    size_t backslashes = 0;
+    while (pos > backslashes && pattern[pos - backslashes - 1] == '\\')
+        ++backslashes;
+    return backslashes % 2 == 1;
+}
+
+// Index past the bracket expression opening at pos
+static size_t skipBracket(const std::string &pattern, size_t pos)
+{
+    size_t i = pos + 1;
+    if (i < pattern.size() && pattern[i] == '^')
+        ++i;
+    if (i < pattern.size() && pattern[i] == ']')
+        ++i;
+    while (i < pattern.size() && pattern[i] != ']')
+    {
+        if (pattern[i] == '[' && i + 1 < pattern.size() && std::strchr(":.=", pattern[i + 1]))
+        {
+            size_t close = pattern.find(std::string(1, pattern[i + 1]) + "]", i + 2);
+            i = close == std::string::npos ? pattern.size() : close + 2;
+            continue;
+        }
+        ++i;
+    }
+    return i < pattern.size() ? i + 1 : i;
+}
+
+// Splits the pattern into atoms, a literal byte or -1 for anything else
+// (groups, brackets, ., quantified atoms), and keeps the literal runs at
+// its anchored ends and the longest one in between. Whatever is unclear
+// becomes -1: the literals may only come out shorter than the regex
+// requires, never longer.
+void LocationRegex::extractLiterals()
+{
+    const std::string &p = pattern_;
+    std::vector<int> atoms;
+    size_t i = 0;
+    size_t end = p.size();
+    int depth = 0;
+    bool anchoredStart = !p.empty() && p[0] == '^';
+    bool anchoredEnd = end > 0 && p[end - 1] == '$' && !isEscaped(p, end - 1);
+
+    if (anchoredStart)
+        ++i;
+    if (anchoredEnd)
+        --end;
+    while (i < end)
+    {
+        char c = p[i];
+        if (c == '\\' && i + 1 < end)
+        {
+            bool literal = depth == 0 && !std::isalnum(static_cast<unsigned char>(p[i + 1]));
+            atoms.push_back(literal ? static_cast<unsigned char>(p[i + 1]) : -1);
+            i += 2;
+            continue;
+        }
+        if (c == '[')
+        {
+            atoms.push_back(-1);
+            i = skipBracket(p, i);
+            continue;
+        }
+        if (c == '|' && depth == 0)
+            return; // an alternative may match without any of the literals
+        if (c == '*' || c == '?' || c == '+' || c == '{')
+        {
+            if (!atoms.empty())
+                atoms.back() = -1;
+            if (c == '{')
+                i = p.find('}', i) == std::string::npos ? end : p.find('}', i);
+        }
+        else if (c == '(')
+            ++depth;
+        else if (c == ')' && depth > 0)
+            --depth;
+        atoms.push_back(depth == 0 && !std::strchr(".^$*?+{}()[]|", c) ? static_cast<unsigned char>(c) : -1);
+        ++i;
+    }
+
+    std::string run;
+    for (size_t a = 0; a <= atoms.size(); ++a)
+    {
+        if (a < atoms.size() && atoms[a] >= 0)
+        {
+            run += static_cast<char>(caseless_ ? std::tolower(atoms[a]) : atoms[a]);
+            continue;
+        }
+        if (anchoredStart && run.size() == a)
+            prefix_ = run;
+        else if (anchoredEnd && a == atoms.size())
+            suffix_ = run;
+        else if (run.size() > infix_.size())
+            infix_ = run;
+        run.clear();
+    }
+}
+
+static bool equalAt(const std::string &target, size_t pos, const std::string &literal, bool caseless)
+{
+    if (!caseless)
+        return target.compare(pos, literal.size(), literal) == 0;
+    for (size_t i = 0; i < literal.size(); ++i)
+    {
+        if (std::tolower(static_cast<unsigned char>(target[pos + i])) != literal[i])
+            return false;
+    }
+    return true;
+}
+
+bool LocationRegex::matches(const std::string &target) const
+{
+    if (target.size() < prefix_.size() || target.size() < suffix_.size() || target.size() < infix_.size())
+        return false;
+    if (!prefix_.empty() && !equalAt(target, 0, prefix_, caseless_))
+        return false;
+    if (!suffix_.empty() && !equalAt(target, target.size() - suffix_.size(), suffix_, caseless_))
+        return false;
+    if (!infix_.empty())
+    {
+        size_t pos = 0;
+        if (!caseless_)
+            pos = target.find(infix_);
+        else
+        {
+            while (pos + infix_.size() <= target.size() && !equalAt(target, pos, infix_, true))
+                ++pos;
+            if (pos + infix_.size() > target.size())
+                pos = std::string::npos;
+        }
+        if (pos == std::string::npos)
+            return false;
+    }
+    return compiled_ && regexec(&regex_, target.c_str(), 0, NULL, 0) == 0;
+}
+
+int LocationRegex::location() const
+{
+    return location_;
+}
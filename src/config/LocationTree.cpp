@@ -0,0 +1,133 @@
+#include "../../inc/LocationTree.hpp"
+#include <algorithm>
+
+LocationTree::Node::Node(const std::string &label) : label(label), prefix(-1), exact(-1)
+{
+}
+
+LocationTree::LocationTree() : nodes_(1, Node(""))
+{
+}
+
+// Child of node whose label starts with byte, -1 if none
+int LocationTree::child(int node, char byte) const
+{
+    const std::string &first = nodes_[node].first;
+    std::string::const_iterator it = std::lower_bound(first.begin(), first.end(), byte);
+    if (it == first.end() || *it != byte)
+        return -1;
+    return nodes_[node].children[it - first.begin()];
+}
+
+int LocationTree::addChild(int node, const std::string &label)
+{
+    int index = nodes_.size();
+    nodes_.push_back(Node(label));
+    Node &parent = nodes_[node];
+    size_t at = std::lower_bound(parent.first.begin(), parent.first.end(), label[0]) - parent.first.begin();
+    parent.first.insert(at, 1, label[0]);
+    parent.children.insert(parent.children.begin() + at, index);
+    return index;
+}
+
+// Adds the location ending at path, splitting an edge where path leaves
+// it. False when a location of the same kind already ends there.
+bool LocationTree::insert(const std::string &path, int location, bool exact)
+{
+    int node = 0;
+    size_t pos = 0;
+
+    while (pos < path.size())
+    {
+        int next = child(node, path[pos]);
+        if (next < 0)
+        {
+            node = addChild(node, path.substr(pos));
+            break;
+        }
+        const std::string &label = nodes_[next].label;
+        size_t common = 1;
+        while (common < label.size() && pos + common < path.size() && label[common] == path[pos + common])
+            ++common;
+        if (common < label.size())
+        {
+            std::string head = label.substr(0, common);
+            std::string tail = label.substr(common);
+            int mid = nodes_.size();
+            nodes_.push_back(Node(head));
+            Node &parent = nodes_[node];
+            parent.children[std::lower_bound(parent.first.begin(), parent.first.end(), head[0]) - parent.first.begin()] = mid;
+            nodes_[next].label = tail;
+            nodes_[mid].first.assign(1, tail[0]);
+            nodes_[mid].children.push_back(next);
+            next = mid;
+        }
+        node = next;
+        pos += common;
+    }
+
+    int &slot = exact ? nodes_[node].exact : nodes_[node].prefix;
+    if (slot >= 0)
+        return false;
+    slot = location;
+    return true;
+}
+
+// The = location of target if there is one (exact set), else the prefix
+// location with the longest path target starts with, -1 for none
+int LocationTree::match(const std::string &target, bool &exact) const
+{
+    int best = -1;
+    int node = 0;
+    size_t pos = 0;
+
+    exact = false;
+    while (true)
+    {
+        const Node &current = nodes_[node];
+        if (pos == target.size() && current.exact >= 0)
+        {
+            exact = true;
+            return current.exact;
+        }
+        if (current.prefix >= 0)
+            best = current.prefix;
+        if (pos == target.size())
+            return best;
+        int next = child(node, target[pos]);
+        if (next < 0 || target.compare(pos, nodes_[next].label.size(), nodes_[next].label) != 0)
+            return best;
+        pos += nodes_[next].label.size();
+        node = next;
+    }
+}
+
+// Node where path ends, -1 if it ends inside an edge or leaves the tree
+int LocationTree::descend(const std::string &path) const
+{
+    int node = 0;
+    size_t pos = 0;
+
+    while (pos < path.size())
+    {
+        node = child(node, path[pos]);
+        if (node < 0 || path.compare(pos, nodes_[node].label.size(), nodes_[node].label) != 0)
+            return -1;
+        pos += nodes_[node].label.size();
+    }
+    return node;
+}
+
+// Location, prefix or exact, whose path is exactly path, -1 for none
+int LocationTree::find(const std::string &path) const
+{
+    int node = descend(path);
+    if (node < 0)
+        return -1;
+    return nodes_[node].prefix >= 0 ? nodes_[node].prefix : nodes_[node].exact;
+}
+
+size_t LocationTree::size() const
+{
+    return nodes_.size();
+}
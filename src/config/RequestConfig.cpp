@@ -1,306 +1,48 @@
 #include "../../inc/AllHeaders.hpp"
 
-RequestConfig::RequestConfig(HttpRequest &request, Listen &host_port, DB &db, Client &client) : request_(request), client_(client), host_port_(host_port), db_(db)
+RequestConfig::RequestConfig(HttpRequest &request, Listen &host_port, const ConfigSnapshot &snapshot, Client &client) : request_(request), client_(client), host_port_(host_port), snapshot_(snapshot), server_(NULL), location_(NULL)
 {
 }
 
 RequestConfig::~RequestConfig()
 {
-    cgi_.clear();
-    error_codes_.clear();
 }
 
-const VecStr &RequestConfig::filterDataByDirectives(const std::vector<KeyMapValue> &targetServ, std::string directive, std::string location = "")
+// target_ and uri_ are the request target past the matched location path
+void RequestConfig::setBestMatch()
 {
-    std::string locationExtract;
+    const std::string &target = request_.getTarget();
 
-    for (size_t i = 0; i < targetServ.size(); ++i)
+    // a regex location has no path to strip, the root takes the whole target
+    if (!location_->path.empty() && !location_->isRegex())
     {
-        const MapStr &keyMap = targetServ[i].first;
-        const VecStr &valueVector = targetServ[i].second;
-
-        MapStr::const_iterator directiveIt = keyMap.find("directives");
-        if (directiveIt != keyMap.end() && directiveIt->second == directive)
-        {
-            MapStr::const_iterator locationIt = keyMap.find("location");
-            if (locationIt != keyMap.end())
-            {
-                locationExtract = locationExtractor(locationIt->second);
-                if (locationExtract == location)
-                    return valueVector;
-            }
-        }
-    }
-
-    static VecStr emptyVector;
-    return emptyVector;
-}
-
-bool RequestConfig::directiveExists(std::string directive, std::string location)
-{
-    for (size_t i = 0; i < targetServer_.size(); ++i)
-    {
-        const MapStr &keyMap = targetServer_[i].first;
-        MapStr::const_iterator dirIt = keyMap.find("directives");
-        MapStr::const_iterator locIt = keyMap.find("location");
-
-        (void)directive;
-
-        if (dirIt != keyMap.end() && locIt != keyMap.end())
-        {
-            std::string dir = dirIt->second;
-            std::string loc = locIt->second;
-
-            if (loc == location && dir == directive)
-            {
-                std::cout << "Checking: Directive = " << dir << ", Location = " << loc << std::endl;
-                return true;
-            }
-        }
-    }
-    return false; // Directive not found in the specified location
-}
-
-const VecStr &RequestConfig::checkRootDB(std::string directive)
-{
-    GroupedDBMap::const_iterator it;
-    for (it = db_.rootDB.begin(); it != db_.rootDB.end(); ++it)
-    {
-        const std::vector<ConfigDB::KeyMapValue> &values = it->second;
-        for (size_t i = 0; i < values.size(); ++i)
-        {
-            const MapStr &keyMap = values[i].first;
-            const VecStr &valueVector = values[i].second;
-            std::string location = keyMap.find("location")->second;
-            const VecStr &dirValue = filterDataByDirectives(values, directive, location);
-            if (!dirValue.empty())
-                return valueVector;
-        }
-    }
-
-    static VecStr emptyVector;
-    return emptyVector;
-}
-
-const VecStr &RequestConfig::cascadeFilter(std::string directive, std::string location = "")
-{
-    /// @note important to first pre-populate data in cascades:
-    // 1. preffered settings
-    // 2. http level
-    // 3. server level(locatn == "" == server-default settings)
-    // 4. location level
-
-    const VecStr &dirValue = filterDataByDirectives(targetServer_, directive, location);
-    if (!dirValue.empty())
-        return dirValue;
-
-    if (dirValue.empty() && !location.empty())
-    {
-        const VecStr &filteredValue = filterDataByDirectives(targetServer_, directive, "");
-        if (!filteredValue.empty())
-            return filteredValue;
-    }
-
-    return checkRootDB(directive);
-}
-std::string RequestConfig::locationExtractor(const std::string &locationStr)
-{
-    size_t j;
-
-    for (j = 0; j < locationStr.size(); ++j)
-    {
-        char ch = locationStr[j];
-
-        if (!(ch == '^' || ch == '*' || ch == '~' || ch == '=' || ch == '_'))
-            break;
-    }
-    return locationStr.substr(j);
-}
-
-LocationModifier RequestConfig::setModifier(const std::string &locationStr)
-{
-    LocationModifier modifierType_ = NONE;
-    std::string modifiers;
-    size_t pos = locationStr.find_first_of("/");
-    if (pos != std::string::npos)
-    {
-        modifiers = locationStr.substr(0, pos);
+        setTarget("/" + target.substr(location_->path.length()));
+        setUri("/" + target.substr(location_->path.length()));
     }
     else
     {
-        return modifierType_;
-    }
-
-    std::set<char> validModifiers;
-    validModifiers.insert('^');
-    validModifiers.insert('*');
-    validModifiers.insert('~');
-    validModifiers.insert('=');
-    validModifiers.insert('_');
-
-    for (size_t j = 0; j < modifiers.size(); ++j)
-    {
-        char ch = modifiers[j];
-
-        if (validModifiers.find(ch) == validModifiers.end())
-            throw std::runtime_error("Invalid location modifier");
-    }
-
-    bool hasTilde = (modifiers.find("~") != std::string::npos);
-    bool hasAsterisk = (modifiers.find("*") != std::string::npos);
-    bool hasCaret = (modifiers.find("^") != std::string::npos);
-    bool hasEquals = (modifiers.find("=") != std::string::npos);
-
-    if (hasCaret && hasTilde)
-        modifierType_ = LONGEST;
-    else if (hasTilde && hasAsterisk)
-        modifierType_ = CASE_INSENSITIVE;
-    else if (hasTilde)
-        modifierType_ = CASE_SENSITIVE;
-    else if (hasEquals)
-        modifierType_ = EXACT;
-
-    return modifierType_;
-}
-
-/**
- * SETTERS
- */
-
-RequestConfig *RequestConfig::getRequestLocation(std::string request_target)
-{
-    RequestConfig *requestConfig = NULL;
-
-    std::map<std::string, int>::iterator it = locationsMap_.begin();
-    while (it != locationsMap_.end())
-    {
-        if (it->second != CASE_SENSITIVE && it->second != CASE_INSENSITIVE)
-        {
-            if (it->second == 1 && it->first == request_target)
-                return &(*this);
-            else if (request_target.find(it->first) == 0)
-            {
-                if (requestConfig && requestConfig->uri_.length() < it->first.length())
-                    requestConfig = &(*this);
-                else if (!requestConfig)
-                    requestConfig = &(*this);
-            }
-        }
-        it++;
-    }
-
-    return requestConfig;
-}
-
-void RequestConfig::setLocationsMap(const std::vector<KeyMapValue> &values)
-{
-    int modifier = NONE;
-    for (size_t i = 0; i < values.size(); ++i)
-    {
-        const MapStr &keyMap = values[i].first;
-        std::string loc = keyMap.find("location")->second;
-        modifier = setModifier(loc);
-
-        if (!loc.empty() && locationsMap_.find(loc) == locationsMap_.end())
-        {
-            locationsMap_[locationExtractor(loc)] = modifier;
-        }
-    }
-}
-
-void RequestConfig::returnRedirection()
-{
-    std::map<int, std::string> m = getRedirectionMap();
-    if (getRedirectionMap().size())
-    {
-        std::map<int, std::string>::const_iterator it = m.begin();
-        for (it = m.begin(); it != m.end(); ++it)
-            request_.setTarget(m[it->first]);
+        setTarget(target);
+        setUri(target);
     }
 }
 
-std::pair<std::string, int> findCaseInsensitive(const std::map<std::string, int> &myMap, const std::string &key)
+// Everything but the location was resolved when the config was loaded. A
+// return in the location rewrites the target once before the final match;
+// a request with a body is set up again for its response, on the target
+// Servers::checkHeaders already rewrote.
+void RequestConfig::setUp(size_t targetServerIdx)
 {
-    std::string lowerKey;
-    std::transform(key.begin(), key.end(), std::back_inserter(lowerKey), ::tolower);
-    for (std::map<std::string, int>::const_iterator it = myMap.begin(); it != myMap.end(); ++it)
+    server_ = &snapshot_.server(targetServerIdx);
+    location_ = &server_->match(request_.getTarget());
+    if (!location_->redirects.empty() && !request_.isRewritten())
     {
-        std::string lowerFirst;
-        std::transform(it->first.begin(), it->first.end(), std::back_inserter(lowerFirst), ::tolower);
-        if (lowerFirst == lowerKey)
-            return *it;
+        request_.setTarget(location_->redirects.rbegin()->second);
+        location_ = &server_->match(request_.getTarget());
     }
-    return std::pair<std::string, int>("", 0);
-}
-
-
-std::string RequestConfig::findLongestMatch()
-{
-    std::string target = request_.getTarget();
-	std::string longestMatch = "";
-
-	std::map<std::string, int>::const_iterator locationsMap = getLocationsMap().begin();
-	while (locationsMap != getLocationsMap().end())
-	{
-		if (target.find(locationsMap->first) == 0 && locationsMap->first.length() > longestMatch.length())
-			longestMatch = locationsMap->first;
-		locationsMap++;
-	}
-    return longestMatch;
+    setBestMatch();
 }
 
-void RequestConfig::setLociMatched(int status)
-{
-    isLociMatched_ = status;
-}
-
-int RequestConfig::getLociMatched()
-{
-    return isLociMatched_;
-}
-
-
-
-void RequestConfig::setBestMatch(std::string &newTarget) {
-    std::string target = request_.getTarget();
-	std::string longestMatch = findLongestMatch();
-
-	if (!longestMatch.empty())
-	{
-        newTarget = target.substr(0, longestMatch.length());
-		target.erase(0, longestMatch.length());
-		setTarget("/" + target);
-		setUri("/" + target);
-	} else {
-        newTarget = request_.getTarget();
-        setTarget(request_.getTarget());
-        setUri(request_.getURI());
-    }
-}
-
-
-void RequestConfig::setUp(size_t targetServerIdx)
-{
-    std::string newTarget;
-    targetServer_ = getDataByIdx(db_.serversDB, targetServerIdx);
-    serverId = targetServerIdx;
-
-    setRedirectMap(cascadeFilter("return", request_.getTarget()));
-    returnRedirection();
-    setLocationsMap(targetServer_);
-    setBestMatch(newTarget);
-    setRoot(cascadeFilter("root", newTarget));
-    setClientMaxBodySize(cascadeFilter("client_max_body_size", newTarget));
-    setAutoIndex(cascadeFilter("autoindex", newTarget));
-    setIndexes(cascadeFilter("index", newTarget));
-    setErrorPages(cascadeFilter("error_page", newTarget));
-    setMethods(cascadeFilter("allow_methods", newTarget));
-    setAuth(cascadeFilter("auth", newTarget));
-    setCgi(cascadeFilter("cgi", newTarget));
-    setCgiBin(cascadeFilter("cgi-bin", newTarget));
-}
-
-void RequestConfig::redirectLocation(std::string target)
+void RequestConfig::redirectLocation(const std::string &target)
 {
     target_ = target;
 }
@@ -310,132 +52,15 @@ void RequestConfig::setTarget(const std::string &target)
     target_ = target;
 }
 
-void RequestConfig::setRoot(const VecStr root)
-{
-
-    root_ = root.empty() ? "html" : root[0];
-}
-
-void RequestConfig::setAuth(const VecStr &auth)
-{
-    auth_ = auth.empty() ? "off" : auth[0];
-}
-
 void RequestConfig::setUri(const std::string uri)
 {
     uri_ = uri;
 }
 
-void RequestConfig::setClientMaxBodySize(const VecStr size)
-{
-    size_t val = size.empty() ? 20971520 : (std::istringstream(size[0]) >> val, val);
-    client_max_body_size_ = val;
-}
-
-void RequestConfig::setUpload(const VecStr &upload)
-{
-    upload_ = upload[0];
-}
-
-void RequestConfig::setAutoIndex(const VecStr autoindex)
-{
-    autoindex_ = autoindex.empty() ? false : (autoindex[0] == "on");
-}
-
-void RequestConfig::setAutoIndex(bool autoindex)
-{
-    autoindex_ = autoindex;
-}
-
-void RequestConfig::setIndexes(const VecStr &indexes)
-{
-    indexes_ = indexes;
-}
-
-void RequestConfig::setMethods(const VecStr &methods)
-{
-    allowed_methods_ = methods.empty() ? cascadeFilter("limit_except", target_) : methods;
-}
-
-void RequestConfig::setCgi(const VecStr &cgi)
-{
-    cgi_ = cgi;
-}
-
-void RequestConfig::setCgiBin(const VecStr &cgi)
-{
-    cgi_bin_ = (cgi_bin_.empty()) ? "" : cgi[0];
-}
-
-void RequestConfig::assignCodes(const std::string &codes, const std::string &page, std::map<int, std::string> &resultMap)
-{
-    std::istringstream codeStream(codes);
-    int code;
-    while (codeStream >> code)
-    {
-        resultMap[code] = page;
-    }
-}
-
-void RequestConfig::setMap(const VecStr &vec, std::map<int, std::string> &resultMap, std::string &codes)
-{
-    if (!vec.empty())
-    {
-        for (size_t i = 0; i < vec.size(); ++i)
-        {
-            std::istringstream iss(vec[i]);
-            int code;
-            if (iss >> code)
-            {
-                // Its a code. concatenate it
-                if (!codes.empty())
-                    codes += " ";
-                codes += vec[i];
-            }
-            else
-            {
-                if (!codes.empty())
-                {
-                    assignCodes(codes, vec[i], resultMap);
-                    codes.clear();
-                }
-            }
-        }
-
-        // Assign the last page to remaining codes
-        if (!codes.empty())
-            assignCodes(codes, vec.back(), resultMap);
-    }
-}
-
-void RequestConfig::setErrorPages(const VecStr &errors)
-{
-    std::map<int, std::string> resultMap;
-    std::string errorCodes;
-    setMap(errors, resultMap, errorCodes);
-    error_codes_ = resultMap;
-}
-
-void RequestConfig::setRedirectMap(const VecStr &redirectMap)
-{
-    std::map<int, std::string> resultMap;
-    std::string redirCodes;
-    setMap(redirectMap, resultMap, redirCodes);
-    redirectMap_ = resultMap;
-}
-
 /**
  * GETTERS
  */
 
-std::map<std::string, std::string> RequestConfig::getHeaders()
-{
-    std::map<std::string, std::string>::const_iterator it;
-    MapStr headers = request_.getHeaders();
-
-    return headers;
-}
-
 std::string &RequestConfig::getTarget()
 {
     return target_;
@@ -456,11 +81,16 @@ std::string &RequestConfig::getFragment()
     return request_.getFragment();
 }
 
-std::string &RequestConfig::getMethod()
+HttpMethod RequestConfig::getMethod() const
 {
     return request_.getMethod();
 }
 
+void RequestConfig::setMethod(HttpMethod method)
+{
+    request_.setMethod(method);
+}
+
 std::string &RequestConfig::getHost()
 {
     return host_port_.ip_;
@@ -481,9 +111,19 @@ Client &RequestConfig::getClient()
     return client_;
 }
 
-std::string &RequestConfig::getRoot()
+const ServerConfig &RequestConfig::getServer() const
+{
+    return *server_;
+}
+
+const LocationConfig &RequestConfig::getLocation() const
+{
+    return *location_;
+}
+
+const std::string &RequestConfig::getRoot() const
 {
-    return root_;
+    return location_->root;
 }
 
 std::string &RequestConfig::getUri()
@@ -491,47 +131,65 @@ std::string &RequestConfig::getUri()
     return uri_;
 }
 
-std::string &RequestConfig::getAuth()
+const std::string &RequestConfig::getAuth() const
 {
-    return auth_;
+    return location_->auth;
 }
 
-size_t &RequestConfig::getClientMaxBodySize()
+// Basic credentials of the request against the location's auth user:password
+bool RequestConfig::checkAuth()
 {
-    return client_max_body_size_;
+    HeaderValue credentials = getHeader(HEADER_AUTHORIZATION);
+    if (credentials.empty())
+        return false;
+    const char *space = static_cast<const char *>(std::memchr(credentials.data, ' ', credentials.size));
+    const char *encoded = space ? space + 1 : credentials.data;
+    size_t len = credentials.data + credentials.size - encoded;
+    std::string token = b64decode(encoded, len);
+    return (token == getAuth());
 }
 
-bool RequestConfig::getAutoIndex()
+size_t RequestConfig::getClientMaxBodySize() const
 {
-    return autoindex_;
+    return location_->client_max_body_size;
 }
 
-std::vector<std::string> &RequestConfig::getIndexes()
+bool RequestConfig::getAutoIndex() const
 {
-    return indexes_;
+    return location_->autoindex;
 }
 
-std::map<int, std::string> &RequestConfig::getErrorPages()
+const VecStr &RequestConfig::getIndexes() const
 {
-    return error_codes_;
+    return location_->indexes;
 }
 
-std::map<int, std::string> &RequestConfig::getRedirectionMap()
+const std::map<int, std::string> &RequestConfig::getErrorPages() const
 {
-    return redirectMap_;
+    return location_->error_pages;
 }
 
-std::vector<std::string> &RequestConfig::getMethods()
+MethodMask RequestConfig::getMethods() const
 {
-    return allowed_methods_;
+    return location_->methods;
 }
 
-const std::string &RequestConfig::getBody() const
+const BodyBuffer &RequestConfig::getBody() const
 {
     return request_.getBody();
 }
 
-std::string &RequestConfig::getHeader(std::string key)
+bool RequestConfig::hasHeader(HeaderId id)
+{
+    return request_.hasHeader(id);
+}
+
+HeaderValue RequestConfig::getHeader(HeaderId id)
+{
+    return request_.getHeader(id);
+}
+
+HeaderValue RequestConfig::getHeader(std::string key)
 {
     std::transform(key.begin(), key.end(), key.begin(), tolower);
     return request_.getHeader(key);
@@ -542,34 +200,29 @@ std::string &RequestConfig::getProtocol()
     return request_.getProtocol();
 }
 
-std::string &RequestConfig::getUpload()
+const std::string &RequestConfig::getUpload() const
 {
-    return upload_;
+    return location_->upload;
 }
 
-std::vector<std::string> &RequestConfig::getCgi()
+const VecStr &RequestConfig::getCgi() const
 {
-    return cgi_;
+    return location_->cgi;
 }
 
-std::string &RequestConfig::getCgiBin()
+const std::string &RequestConfig::getCgiBin() const
 {
-    return cgi_bin_;
+    return location_->cgi_bin;
 }
 
-std::map<std::string, int> &RequestConfig::getLocationsMap()
+uint64_t RequestConfig::getCgiTimeout() const
 {
-    return locationsMap_;
+    return location_->cgi_timeout;
 }
 
-bool RequestConfig::isMethodAccepted(std::string &method)
+bool RequestConfig::isMethodAccepted(HttpMethod method) const
 {
-    bool methodFlag = directiveExists("allow_methods", target_) || directiveExists("limit_except", target_);
-
-    if (!methodFlag)
-        return true;
-
-    return (allowed_methods_[0] == "none" || method.empty()) ? false : (std::find(allowed_methods_.begin(), allowed_methods_.end(), method) != allowed_methods_.end());
+    return location_->methods & METHOD_BIT(method);
 }
 
 void RequestConfig::printConfigSetUp()
@@ -580,22 +233,21 @@ void RequestConfig::printConfigSetUp()
     std::cout << "\nROOT: " << getRoot() << std::endl;
     std::cout << "\nHOST: " << getHost() << std::endl;
     std::cout << "\nPORT: " << getPort() << std::endl;
-    std::cout << "\nMETHOD: " << getMethod() << std::endl;
+    std::cout << "\nMETHOD: " << Methods::name(getMethod()) << std::endl;
     std::cout << "\nCLIENTMAXBODY: " << getClientMaxBodySize() << std::endl;
     std::cout << "\nAUTOINDEX: " << getAutoIndex() << std::endl;
     std::cout << getProtocol() << std::endl;
-    std::cout << "\nBODY: " << getBody() << std::endl;
+    std::cout << "\nBODY: " << getBody().size() << " bytes" << std::endl;
     std::cout << "\nINDEXES: \n";
     printVec(getIndexes(), "SETUP");
     std::cout << "\nERRORPAGES\n";
     printMap(getErrorPages());
-    std::cout << "\nMETHODS\n";
-    printVec(getMethods(), "SETUP");
+    std::cout << "\nMETHODS: " << Methods::allowHeader(getMethods()) << std::endl;
     std::cout << "\nHEADERS\n";
-    printMap(getHeaders());
+    printMap(request_.getHeaders());
     std::cout << std::endl;
     std::cout << "\nCGI\n";
-    printVec(cgi_, "SETUP");
+    printVec(getCgi(), "SETUP");
     std::cout << std::endl;
     std::cout << "\nCGI-BIN: " << getCgiBin() << std::endl;
 
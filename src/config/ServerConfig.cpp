@@ -0,0 +1,251 @@
+#include "../../inc/AllHeaders.hpp"
+
+// Values of each directive at one level, the first entry naming it wins
+typedef std::map<std::string, const VecStr *> Scope;
+
+LocationConfig::LocationConfig() : modifier(NONE), root(DEFAULT_ROOT), client_max_body_size(DEFAULT_CLIENT_MAX_BODY_SIZE), autoindex(false), methods(METHODS_IMPLEMENTED), auth("off"), cgi_timeout(DEFAULT_CGI_TIMEOUT * 1000)
+{
+}
+
+bool LocationConfig::isRegex() const
+{
+    return modifier == CASE_SENSITIVE || modifier == CASE_INSENSITIVE;
+}
+
+static void addDirective(Scope &scope, const MapStr &keys, const VecStr &values)
+{
+    const std::string &directive = keys.find("directives")->second;
+    if (!values.empty() && scope.find(directive) == scope.end())
+        scope[directive] = &values;
+}
+
+// ConfigDB keeps "location ^~ /data" as "^~_/data", a space turned into
+// '_': a leading =, ~, ~* or ^~ token is the modifier, the rest the path
+// (or pattern)
+static LocationModifier parseLocation(const std::string &location, std::string &path)
+{
+    static const struct
+    {
+        const char *token;
+        LocationModifier modifier;
+    } modifiers[] = {{"^~", LONGEST}, {"~*", CASE_INSENSITIVE}, {"~", CASE_SENSITIVE}, {"=", EXACT}};
+    LocationModifier modifier = NONE;
+    size_t pos = location.find_first_not_of('_');
+
+    for (size_t i = 0; pos != std::string::npos && i < sizeof(modifiers) / sizeof(modifiers[0]); ++i)
+    {
+        size_t len = std::strlen(modifiers[i].token);
+        if (location.compare(pos, len, modifiers[i].token) != 0)
+            continue;
+        if (pos + len == location.size() || !std::strchr("^*~=", location[pos + len]))
+        {
+            modifier = modifiers[i].modifier;
+            pos += len;
+        }
+        break;
+    }
+    if (modifier == NONE && pos != std::string::npos && std::strchr("^*~=", location[pos]))
+    {
+        std::cerr << "Invalid location modifier: " << location << std::endl;
+        exit(1);
+    }
+    pos = location.find_first_not_of('_', pos == std::string::npos ? location.size() : pos);
+    path = pos == std::string::npos ? "" : location.substr(pos);
+    return modifier;
+}
+
+// "404 403 /errors/4xx.html 500 /errors/500.html": each page takes the
+// codes in front of it, codes left at the end take the last value
+static std::map<int, std::string> codeMap(const VecStr &values)
+{
+    std::map<int, std::string> codes;
+    std::vector<int> pending;
+
+    for (size_t i = 0; i < values.size(); ++i)
+    {
+        if (std::isdigit(static_cast<unsigned char>(values[i][0])))
+        {
+            pending.push_back(std::atoi(values[i].c_str()));
+            continue;
+        }
+        for (size_t j = 0; j < pending.size(); ++j)
+            codes[pending[j]] = values[i];
+        pending.clear();
+    }
+    for (size_t j = 0; j < pending.size(); ++j)
+        codes[pending[j]] = values.back();
+    return codes;
+}
+
+// Looks a directive up location first, then server, then http
+class Cascade
+{
+public:
+    Cascade(const Scope *location, const Scope &server, const Scope &root)
+    {
+        levels_[0] = location;
+        levels_[1] = &server;
+        levels_[2] = &root;
+    }
+
+    const VecStr &get(const std::string &directive) const
+    {
+        static const VecStr none;
+        for (size_t i = 0; i < 3; ++i)
+        {
+            const VecStr *values = level(i, directive);
+            if (values)
+                return *values;
+        }
+        return none;
+    }
+
+    std::string first(const std::string &directive, const std::string &fallback) const
+    {
+        const VecStr &values = get(directive);
+        return values.empty() ? fallback : values[0];
+    }
+
+    // allow_methods or limit_except, from the nearest level naming either,
+    // else every method with a handler
+    MethodMask methods() const
+    {
+        for (size_t i = 0; i < 3; ++i)
+        {
+            const VecStr *values = level(i, "allow_methods");
+            if (!values)
+                values = level(i, "limit_except");
+            if (values)
+                return Methods::compile(*values);
+        }
+        return METHODS_IMPLEMENTED;
+    }
+
+private:
+    const VecStr *level(size_t i, const std::string &directive) const
+    {
+        if (!levels_[i])
+            return NULL;
+        Scope::const_iterator it = levels_[i]->find(directive);
+        return it == levels_[i]->end() ? NULL : it->second;
+    }
+
+    const Scope *levels_[3];
+};
+
+static void resolve(LocationConfig &location, const Cascade &cascade)
+{
+    const VecStr &size = cascade.get("client_max_body_size");
+    const VecStr &timeout = cascade.get("cgi_timeout");
+
+    location.root = cascade.first("root", DEFAULT_ROOT);
+    location.client_max_body_size = DEFAULT_CLIENT_MAX_BODY_SIZE;
+    if (!size.empty() && !parseSize(size[0], location.client_max_body_size))
+    {
+        std::cerr << "Invalid client_max_body_size: " << size[0] << std::endl;
+        exit(1);
+    }
+    location.autoindex = cascade.first("autoindex", "off") == "on";
+    location.indexes = cascade.get("index");
+    location.error_pages = codeMap(cascade.get("error_page"));
+    location.redirects = codeMap(cascade.get("return"));
+    location.methods = cascade.methods();
+    location.auth = cascade.first("auth", "off");
+    location.upload = cascade.first("upload", "");
+    location.cgi = cascade.get("cgi");
+    location.cgi_bin = cascade.first("cgi-bin", "");
+    location.cgi_timeout = timeout.empty() ? DEFAULT_CGI_TIMEOUT * 1000 : parseMsec(timeout[0]);
+}
+
+// Entries of the server block and of the blocks outside any server, as
+// ConfigDB groups them, resolved into one LocationConfig per location.
+// order lists the locations as they appear in the block, regex locations
+// are tried in that order.
+void ServerConfig::compile(const std::vector<KeyMapValue> &server, const GroupedDBMap &root, const VecStr &order)
+{
+    Scope rootScope;
+    Scope serverScope;
+    std::map<std::string, Scope> locationScopes; // by location as written
+    VecStr written; // in config order, each once
+    std::set<std::string> seen;
+
+    for (GroupedDBMap::const_iterator it = root.begin(); it != root.end(); ++it)
+    {
+        for (size_t i = 0; i < it->second.size(); ++i)
+            addDirective(rootScope, it->second[i].first, it->second[i].second);
+    }
+    for (size_t i = 0; i < server.size(); ++i)
+    {
+        const MapStr &keys = server[i].first;
+        const std::string &location = keys.find("location")->second;
+        addDirective(location.empty() ? serverScope : locationScopes[location], keys, server[i].second);
+    }
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        if (seen.insert(order[i]).second)
+            written.push_back(order[i]);
+    }
+    for (std::map<std::string, Scope>::const_iterator it = locationScopes.begin(); it != locationScopes.end(); ++it)
+    {
+        if (seen.insert(it->first).second)
+            written.push_back(it->first);
+    }
+
+    if (serverScope.count("server_name"))
+        names = *serverScope["server_name"];
+    // read by Servers per server block, checked here with the rest
+    const VecStr &buffer = Cascade(NULL, serverScope, rootScope).get("client_body_buffer_size");
+    size_t size;
+    if (!buffer.empty() && !parseSize(buffer[0], size))
+    {
+        std::cerr << "Invalid client_body_buffer_size: " << buffer[0] << std::endl;
+        exit(1);
+    }
+    resolve(defaults, Cascade(NULL, serverScope, rootScope));
+    for (size_t i = 0; i < written.size(); ++i)
+    {
+        LocationConfig location;
+        location.modifier = parseLocation(written[i], location.path);
+        resolve(location, Cascade(&locationScopes[written[i]], serverScope, rootScope));
+        locations.push_back(location);
+        int index = locations.size() - 1;
+        if (location.isRegex())
+        {
+            regexes.push_back(LocationRegex());
+            if (!regexes.back().compile(location.path, location.modifier == CASE_INSENSITIVE, index))
+            {
+                std::cerr << "Invalid location regex: " << written[i] << std::endl;
+                exit(1);
+            }
+        }
+        else if (!prefixes.insert(location.path, index, location.modifier == EXACT))
+        {
+            std::cerr << "Duplicate location: " << written[i] << std::endl;
+            exit(1);
+        }
+    }
+}
+
+// nginx order: the = location equal to the target, else the longest
+// prefix location if it is ^~, else the first regex location matching,
+// else that longest prefix
+const LocationConfig &ServerConfig::match(const std::string &target) const
+{
+    bool exact;
+    int found = prefixes.match(target, exact);
+
+    if (exact || (found >= 0 && locations[found].modifier == LONGEST))
+        return locations[found];
+    for (size_t i = 0; i < regexes.size(); ++i)
+    {
+        if (regexes[i].matches(target))
+            return locations[regexes[i].location()];
+    }
+    return found < 0 ? defaults : locations[found];
+}
+
+const LocationConfig *ServerConfig::find(const std::string &path) const
+{
+    int found = prefixes.find(path);
+    return found < 0 ? NULL : &locations[found];
+}
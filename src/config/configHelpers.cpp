@@ -84,9 +84,9 @@ void printData(const std::vector<ConfigDB::KeyMapValue>& values) {
     }
 }
 
-std::vector<KeyMapValue> getDataByIdx(GroupedDBMap db, int index) {
-    std::vector<KeyMapValue> values;
-    GroupedDBMap::iterator it = db.find(index);
+const std::vector<KeyMapValue> &getDataByIdx(const GroupedDBMap &db, int index) {
+    static const std::vector<KeyMapValue> values;
+    GroupedDBMap::const_iterator it = db.find(index);
 
     return (it != db.end())
         ? it->second
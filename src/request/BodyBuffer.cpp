@@ -0,0 +1,135 @@
+#include "../../inc/BodyBuffer.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <unistd.h>
+
+// write() until everything went out; regular files and blocking pipes only
+static bool writeAll(int fd, const char *data, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t written = write(fd, data, len);
+        if (written == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        data += written;
+        len -= written;
+    }
+    return true;
+}
+
+BodyBuffer::BodyBuffer()
+    : memory_max_(DEFAULT_CLIENT_BODY_BUFFER_SIZE), temp_path_(DEFAULT_CLIENT_BODY_TEMP_PATH), fd_(-1), size_(0)
+{
+}
+
+BodyBuffer::~BodyBuffer()
+{
+    clear();
+}
+
+// client_body_buffer_size and client_body_temp_path of the server
+void BodyBuffer::configure(size_t memory_max, const std::string &temp_path)
+{
+    memory_max_ = memory_max;
+    temp_path_ = temp_path;
+}
+
+// Returns false when the temp file could not be created or written
+bool BodyBuffer::append(const char *data, size_t len)
+{
+    if (fd_ == -1 && memory_.size() + len > memory_max_ && !spill())
+        return false;
+    if (fd_ == -1)
+        memory_.append(data, len);
+    else if (!writeAll(fd_, data, len))
+    {
+        std::cerr << "client body temp file: " << strerror(errno) << std::endl;
+        return false;
+    }
+    size_ += len;
+    return true;
+}
+
+/// @note memory_ keeps its capacity, at most client_body_buffer_size, for
+/// the next request of the connection
+void BodyBuffer::clear()
+{
+    if (fd_ != -1)
+        close(fd_);
+    fd_ = -1;
+    memory_.clear();
+    size_ = 0;
+}
+
+size_t BodyBuffer::size() const
+{
+    return size_;
+}
+
+bool BodyBuffer::inFile() const
+{
+    return fd_ != -1;
+}
+
+// Copies up to len body bytes starting at offset, 0 once past the end
+ssize_t BodyBuffer::read(size_t offset, char *buf, size_t len) const
+{
+    if (offset >= size_)
+        return 0;
+    len = std::min(len, size_ - offset);
+    if (fd_ == -1)
+    {
+        memory_.copy(buf, len, offset);
+        return len;
+    }
+    return pread(fd_, buf, len, offset);
+}
+
+// Writes the whole body to fd, in BODY_STREAM_CHUNK pieces when it is in a file
+bool BodyBuffer::writeTo(int fd) const
+{
+    if (fd_ == -1)
+        return writeAll(fd, memory_.data(), memory_.size());
+
+    char buf[BODY_STREAM_CHUNK];
+    size_t offset = 0;
+    while (offset < size_)
+    {
+        ssize_t got = read(offset, buf, sizeof(buf));
+        if (got <= 0 || !writeAll(fd, buf, got))
+            return false;
+        offset += got;
+    }
+    return true;
+}
+
+// Moves the body to a temp file that is unlinked right away, so it goes
+// away with the descriptor even if the process dies
+bool BodyBuffer::spill()
+{
+    std::string name = temp_path_ + "/webserv_body_XXXXXX";
+    int fd = mkostemp(&name[0], O_CLOEXEC);
+    if (fd == -1)
+    {
+        std::cerr << "client body temp file in " << temp_path_ << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    unlink(name.c_str());
+    if (!writeAll(fd, memory_.data(), memory_.size()))
+    {
+        std::cerr << "client body temp file: " << strerror(errno) << std::endl;
+        close(fd);
+        return false;
+    }
+    fd_ = fd;
+    std::string().swap(memory_);
+    return true;
+}
@@ -1,26 +1,118 @@
 #include "../../inc/HttpRequest.hpp"
+#include "../../inc/Scanner.hpp"
 
 HttpRequest::HttpRequest()
 {
-  body_offset_ = 0;
+  parse_pos_ = 0;
+  scan_pos_ = 0;
+  head_end_ = 0;
+  length_ = 0;
+  max_body_size_ = 0;
   chunk_size_ = 0;
+  chunk_line_ = 0;
+  trailer_size_ = 0;
   buffer_section_ = REQUEST_LINE;
+  method_ = METHOD_UNKNOWN;
   protocol_ = "HTTP/1.1";
   isChunked_ = false;
-  gettimeofday(&start_tv_, NULL);
+  rewritten_ = false;
+  chunk_status_ = CHUNK_SIZE;
+  header_count_ = 0;
+  std::memset(known_, 0, sizeof(known_));
 }
 
 HttpRequest::~HttpRequest() {}
 
+/// @note clear() keeps the capacity of every string, so a keep-alive
+/// connection parses its next request into the buffers it already owns.
+void HttpRequest::reset()
+{
+  method_ = METHOD_UNKNOWN;
+  uri_.clear();
+  scheme_.clear();
+  authority_.clear();
+  path_.clear();
+  query_.clear();
+  frag_.clear();
+  protocol_ = "HTTP/1.1";
+  std::memset(known_, 0, sizeof(known_));
+  others_.clear();
+  header_count_ = 0;
+  body_.clear();
+  req_buffer_.clear();
+  uri_suffix_.clear();
+  parse_pos_ = 0;
+  scan_pos_ = 0;
+  head_end_ = 0;
+  length_ = 0;
+  max_body_size_ = 0;
+  chunk_size_ = 0;
+  chunk_line_ = 0;
+  trailer_size_ = 0;
+  isChunked_ = false;
+  rewritten_ = false;
+  chunk_status_ = CHUNK_SIZE;
+  buffer_section_ = REQUEST_LINE;
+}
+
+// Hands bytes past the end of a complete request back to the connection:
+// they are the start of the next, pipelined request
+void HttpRequest::takeUnparsed(std::string &buffer)
+{
+  buffer.insert(0, req_buffer_, parse_pos_, std::string::npos);
+  req_buffer_.clear();
+  parse_pos_ = 0;
+  scan_pos_ = 0;
+}
+
+bool HttpRequest::hasStarted() const
+{
+  return buffer_section_ != REQUEST_LINE || parse_pos_ < req_buffer_.size();
+}
+
+bool HttpRequest::inBody() const
+{
+  return buffer_section_ == BODY || buffer_section_ == CHUNK;
+}
+
+bool HttpRequest::isComplete() const
+{
+  return buffer_section_ == COMPLETE;
+}
+
+// HTTP/1.0 clients do not know 100 Continue (RFC 9110 10.1.1)
+bool HttpRequest::expectsContinue() const
+{
+  return known_[HEADER_EXPECT].name_len && protocol_ != "HTTP/1.0";
+}
+
+// HTTP/1.1 connections persist unless the client asks to close,
+// HTTP/1.0 ones only when the client asks to keep them
+bool HttpRequest::keepAlive()
+{
+  const Header *header = findHeader(HEADER_CONNECTION);
+  std::string value = header ? headerValue(*header) : "";
+  std::transform(value.begin(), value.end(), value.begin(), ::tolower);
+
+  if (value.find("close") != std::string::npos)
+    return false;
+  if (protocol_ == "HTTP/1.0")
+    return value.find("keep-alive") != std::string::npos;
+  return true;
+}
+
+// Returns REQUEST_INCOMPLETE, REQUEST_COMPLETE or an error status. When a
+// body follows the headers it first stops with REQUEST_HEADERS_DONE, before
+// taking any body byte, and goes on with the body on the next call.
 int HttpRequest::parseRequest(std::string &buffer)
 {
-  size_t httpStatus = 0;
-  std::string headerLines;
-  std::string headers;
-  std::string requestLine;
+  int httpStatus = REQUEST_INCOMPLETE;
 
-  gettimeofday(&last_tv_, NULL);
-  req_buffer_.append(buffer);
+  // a fresh request takes over the connection's buffer instead of copying it
+  if (req_buffer_.empty())
+    req_buffer_.swap(buffer);
+  else
+    req_buffer_.append(buffer);
   buffer.clear();
 
   if (buffer_section_ == REQUEST_LINE)
@@ -28,43 +120,90 @@ int HttpRequest::parseRequest(std::string &buffer)
   if (buffer_section_ == HEADERS)
     httpStatus = parseHeaders();
   if (buffer_section_ == SPECIAL_HEADERS)
+  {
     httpStatus = checkSpecialHeaders();
+    if (httpStatus == REQUEST_INCOMPLETE && inBody())
+      return REQUEST_HEADERS_DONE;
+  }
 
   if (buffer_section_ == BODY)
     httpStatus = parseBody();
   else if (buffer_section_ == CHUNK)
     httpStatus = parseChunkedBody();
 
-  if (buffer_section_ == COMPLETE || httpStatus == 100)
+  if (buffer_section_ == COMPLETE || httpStatus == REQUEST_COMPLETE)
     buffer_section_ = COMPLETE;
-  else if (buffer_section_ == ERROR || (httpStatus != 200 && httpStatus != 100))
+  else if (buffer_section_ == ERROR || httpStatus != REQUEST_INCOMPLETE)
     buffer_section_ = ERROR;
 
+  // body bytes already copied out are dropped; the header slices before
+  // head_end_ stay where they are
+  if (head_end_ && parse_pos_ > head_end_ && buffer_section_ != ERROR)
+  {
+    size_t consumed = parse_pos_ - head_end_;
+    req_buffer_.erase(head_end_, consumed);
+    parse_pos_ = head_end_;
+    scan_pos_ -= std::min(scan_pos_, consumed);
+  }
   return httpStatus;
 }
 
-void HttpRequest::parseContentLength()
+// Next CRLF at or after parse_pos_. The search resumes where the previous
+// one gave up, so a line arriving in pieces is scanned only once.
+size_t HttpRequest::findLineEnd()
 {
-  std::map<std::string, std::string>::iterator it = headers_.find("Content-Length");
-  if (it != headers_.end())
-  {
-    std::istringstream iss(it->second);
-    size_t contentLength;
-    if (!(iss >> contentLength))
-      throw std::invalid_argument("Invalid Content-Length value");
+  size_t from = std::max(scan_pos_, parse_pos_);
+  if (from >= req_buffer_.size())
+    return std::string::npos;
+  size_t end = from + Scanner::lineEnd(req_buffer_.data() + from, req_buffer_.size() - from);
+  if (end < req_buffer_.size())
+    return end;
+  scan_pos_ = req_buffer_.size() - 1; // a CR may end the buffer
+  return std::string::npos;
+}
 
-    if (contentLength > body_.size())
-      throw std::invalid_argument("Incomplete body");
+const HttpRequest::Header *HttpRequest::findHeader(HeaderId id) const
+{
+  return known_[id].name_len ? &known_[id] : NULL;
+}
 
-    body_ = body_.substr(0, contentLength);
+// name in lowercase. The last field of that name wins, like repeated
+// headers used to.
+const HttpRequest::Header *HttpRequest::findHeader(const char *name, size_t len) const
+{
+  HeaderId id = KnownHeaders::lookup(name, len);
+  if (id != HEADER_OTHER)
+    return findHeader(id);
+  for (size_t i = others_.size(); i > 0; --i)
+  {
+    const Header &header = others_[i - 1];
+    if (header.name_len == len && req_buffer_.compare(header.name, len, name) == 0)
+      return &header;
   }
+  return NULL;
 }
 
-std::string &HttpRequest::getMethod()
+std::string HttpRequest::headerValue(const Header &header) const
+{
+  return req_buffer_.substr(header.value, header.value_len);
+}
+
+bool HttpRequest::headerEquals(const Header &header, const char *value) const
+{
+  return req_buffer_.compare(header.value, header.value_len, value) == 0;
+}
+
+HttpMethod HttpRequest::getMethod() const
 {
   return method_;
 }
 
+// An error page is served as GET whatever the request was
+void HttpRequest::setMethod(HttpMethod method)
+{
+  method_ = method;
+}
+
 std::string &HttpRequest::getURI()
 {
   return uri_;
@@ -77,14 +216,28 @@ std::string &HttpRequest::getProtocol()
 
 std::map<std::string, std::string> HttpRequest::getHeaders() const
 {
-  return headers_;
+  std::map<std::string, std::string> headers;
+  for (size_t i = 0; i < HEADER_COUNT; ++i)
+  {
+    if (known_[i].name_len)
+      headers[KnownHeaders::name(static_cast<HeaderId>(i))] = headerValue(known_[i]);
+  }
+  for (size_t i = 0; i < others_.size(); ++i)
+    headers[req_buffer_.substr(others_[i].name, others_[i].name_len)] = headerValue(others_[i]);
+  return headers;
 }
 
-const std::string &HttpRequest::getBody() const
+const BodyBuffer &HttpRequest::getBody() const
 {
   return body_;
 }
 
+// Bodies larger than memory_max go to a temp file in temp_path
+void HttpRequest::setBodyBuffer(size_t memory_max, const std::string &temp_path)
+{
+  body_.configure(memory_max, temp_path);
+}
+
 std::string &HttpRequest::getPath()
 {
   return path_;
@@ -100,19 +253,53 @@ std::string &HttpRequest::getFragment()
   return frag_;
 }
 
-std::string &HttpRequest::getHeader(std::string key)
+// A field with an empty value counts as absent
+bool HttpRequest::hasHeader(HeaderId id) const
+{
+  return known_[id].value_len != 0;
+}
+
+static HeaderValue slice(const std::string &buffer, size_t offset, size_t len)
 {
-  return headers_[key];
+  HeaderValue value = {buffer.data() + offset, len};
+  return value;
 }
 
-void HttpRequest::setTarget(std::string target)
+HeaderValue HttpRequest::getHeader(HeaderId id) const
 {
-  target_ = target;
+  const Header *header = findHeader(id);
+  return header ? slice(req_buffer_, header->value, header->value_len) : slice(req_buffer_, 0, 0);
 }
 
-std::string HttpRequest::getTarget() const
+// key in lowercase
+HeaderValue HttpRequest::getHeader(const std::string &key) const
 {
-  return target_;
+  const Header *header = findHeader(key.data(), key.size());
+  return header ? slice(req_buffer_, header->value, header->value_len) : slice(req_buffer_, 0, 0);
+}
+
+// The authority of an absolute-form target, which overrides the Host
+// field (RFC 9112 3.2.2), else that field
+std::string HttpRequest::getHost() const
+{
+  return authority_.empty() ? getHeader(HEADER_HOST).str() : authority_;
+}
+
+// The normalized path is the routing target, return rewrites it in place
+void HttpRequest::setTarget(const std::string &target)
+{
+  path_ = target;
+  rewritten_ = true;
+}
+
+bool HttpRequest::isRewritten() const
+{
+  return rewritten_;
+}
+
+const std::string &HttpRequest::getTarget() const
+{
+  return path_;
 }
 
 size_t HttpRequest::getContentLength()
@@ -120,6 +307,12 @@ size_t HttpRequest::getContentLength()
   return length_;
 }
 
+// client_max_body_size of the location, checked as a chunked body grows
+void HttpRequest::setMaxBodySize(size_t size)
+{
+  max_body_size_ = size;
+}
+
 bool HttpRequest::timeout()
 {
   if (buffer_section_ != COMPLETE)
@@ -135,16 +328,6 @@ int HttpRequest::getStatus()
   return buffer_section_;
 }
 
-time_t HttpRequest::get_start_timer_in_sec()
-{
-  return start_tv_.tv_sec;
-}
-
-time_t HttpRequest::get_last_timer_in_sec()
-{
-  return last_tv_.tv_sec;
-}
-
 void HttpRequest::print_uri_extracts()
 {
   std::cout << "uri: " << uri_ << "\n"
@@ -156,11 +339,11 @@ void HttpRequest::print_uri_extracts()
   std::cout << "fragment: " << frag_ << std::endl;
 }
 
-void HttpRequest::printRequest(HttpRequest parser)
+void HttpRequest::printRequest(HttpRequest &parser)
 {
   try
   {
-    std::cout << "Method: " << parser.getMethod() << std::endl;
+    std::cout << "Method: " << Methods::name(parser.getMethod()) << std::endl;
     std::cout << "Target: " << parser.getURI() << std::endl;
     std::cout << "Protocol: " << parser.getProtocol() << std::endl;
     std::cout << "Headers:" << std::endl;
@@ -170,7 +353,7 @@ void HttpRequest::printRequest(HttpRequest parser)
     {
       std::cout << it->first << ": " << it->second << std::endl;
     }
-    std::cout << "Body: " << parser.getBody() << std::endl;
+    std::cout << "Body: " << parser.getBody().size() << " bytes" << std::endl;
     std::cout << "-------------------------------\n";
   }
   catch (const std::exception &e)
@@ -0,0 +1,66 @@
+#include "../../inc/KnownHeaders.hpp"
+#include <cstring>
+
+// Indexed by HeaderId
+static const char *const g_names[HEADER_COUNT] = {
+    "host",
+    "content-length",
+    "content-type",
+    "transfer-encoding",
+    "connection",
+    "accept",
+    "accept-charset",
+    "accept-encoding",
+    "accept-language",
+    "authorization",
+    "cookie",
+    "user-agent",
+    "referer",
+    "expect",
+    "if-modified-since",
+    "if-none-match",
+    "range",
+    "keep-alive",
+    "te",
+    "trailer",
+    "upgrade",
+    "cache-control",
+    "origin",
+    "x-forwarded-for",
+};
+
+// HeaderId + 1 of the name hashing to each slot, 0 for none. hashName has
+// no collisions over g_names; adding a name means searching new
+// multipliers and rebuilding this table.
+static const unsigned char g_slots[64] = {
+     0,  0,  0,  4, 16,  2,  0,  0,  0, 23, 19,  0,  0,  0,  0,  0,
+     0,  0,  9,  0,  0, 11,  0,  0,  0,  5,  0, 12,  0, 17, 22,  0,
+     0,  0,  8,  7,  1,  0,  0,  0, 15,  0,  0,  6, 10,  0, 21, 14,
+     0, 24,  0, 13,  0, 20,  0,  0,  0, 18,  0,  0,  0,  0,  0,  3,
+};
+
+static size_t hashName(const char *name, size_t len)
+{
+    unsigned char first = name[0];
+    unsigned char last = name[len - 1];
+    return (len * 7 + first + last * 40) & 63;
+}
+
+// name must already be lowercase, as the parser leaves it
+HeaderId KnownHeaders::lookup(const char *name, size_t len)
+{
+    if (len == 0)
+        return HEADER_OTHER;
+    unsigned slot = g_slots[hashName(name, len)];
+    if (slot == 0)
+        return HEADER_OTHER;
+    HeaderId id = static_cast<HeaderId>(slot - 1);
+    if (std::strlen(g_names[id]) != len || std::memcmp(g_names[id], name, len) != 0)
+        return HEADER_OTHER;
+    return id;
+}
+
+const char *KnownHeaders::name(HeaderId id)
+{
+    return id < HEADER_COUNT ? g_names[id] : "";
+}
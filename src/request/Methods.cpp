@@ -0,0 +1,74 @@
+#include "../../inc/Methods.hpp"
+#include <cstring>
+
+// Indexed by HttpMethod
+static const char *const g_names[METHOD_COUNT] = {
+    "GET",
+    "HEAD",
+    "POST",
+    "PUT",
+    "DELETE",
+    "PATCH",
+    "OPTIONS",
+    "TRACE",
+    "CONNECT",
+};
+
+// Case-sensitive, method tokens are uppercase (RFC 9110 9.1)
+HttpMethod Methods::lookup(const char *token, size_t len)
+{
+    for (int m = 0; m < METHOD_COUNT; ++m)
+    {
+        if (std::strlen(g_names[m]) == len && std::memcmp(g_names[m], token, len) == 0)
+            return static_cast<HttpMethod>(m);
+    }
+    return METHOD_UNKNOWN;
+}
+
+const char *Methods::name(HttpMethod method)
+{
+    return method < METHOD_COUNT ? g_names[method] : "";
+}
+
+// "none" and names the server does not know add nothing. GET brings HEAD
+// along, as in nginx's limit_except.
+MethodMask Methods::compile(const std::vector<std::string> &names)
+{
+    MethodMask mask = 0;
+    for (size_t i = 0; i < names.size(); ++i)
+    {
+        HttpMethod method = lookup(names[i].data(), names[i].size());
+        if (method != METHOD_UNKNOWN)
+            mask |= METHOD_BIT(method);
+    }
+    if (mask & METHOD_BIT(METHOD_GET))
+        mask |= METHOD_BIT(METHOD_HEAD);
+    return mask;
+}
+
+// "GET, POST" style lists for every mask, in HttpMethod order
+struct AllowTable
+{
+    std::string values[METHODS_ALL + 1];
+
+    AllowTable()
+    {
+        for (MethodMask mask = 0; mask <= METHODS_ALL; ++mask)
+        {
+            for (int m = 0; m < METHOD_COUNT; ++m)
+            {
+                if (!(mask & METHOD_BIT(m)))
+                    continue;
+                if (!values[mask].empty())
+                    values[mask] += ", ";
+                values[mask] += g_names[m];
+            }
+        }
+    }
+};
+
+const std::string &Methods::allowHeader(MethodMask mask)
+{
+    static const AllowTable table;
+    return table.values[mask & METHODS_ALL];
+}
@@ -1,110 +1,148 @@
 #include "../../inc/HttpRequest.hpp"
 
+// Moves whatever part of the Content-Length body has arrived into body_
 int HttpRequest::parseBody()
 {
+    size_t take = std::min(req_buffer_.size() - parse_pos_, length_ - body_.size());
 
-    if (req_buffer_.length() >= length_)
-    {
-        body_.append(req_buffer_, 0, length_);
-        req_buffer_.erase(0, length_);
-        body_offset_ += req_buffer_.length();
+    if (!body_.append(req_buffer_.data() + parse_pos_, take))
+        return 500;
+    parse_pos_ += take;
+    return (body_.size() == length_) ? REQUEST_COMPLETE : REQUEST_INCOMPLETE;
+}
 
-        return (body_.length() == length_) ? 100 : 400;
-    }
-    return 200;
+// Value of a hex digit, -1 for any other byte
+static int hexDigit(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    c |= 0x20;
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    return -1;
 }
 
+// Decodes the chunked framing one byte at a time, resuming in whatever
+// state the previous read stopped. Chunk data goes from req_buffer_
+// straight into body_.
 int HttpRequest::parseChunkedBody()
 {
-    size_t end;
+    const char *data = req_buffer_.data();
+    size_t end = req_buffer_.size();
+    size_t pos = parse_pos_;
+    int status;
 
-    while ((end = req_buffer_.find("\r\n")) != std::string::npos)
+    while (pos < end)
     {
-        if (chunk_status_ == CHUNK_SIZE)
-        {
-            std::string hex = req_buffer_.substr(0, end);
-            int parseResult = parseChunkSize(hex);
-            if (parseResult != 0)
-                return parseResult;
-            req_buffer_.erase(0, end + 2); // Remove processed chunk size
-            chunk_status_ = CHUNK_BODY;
-        }
-        else if (chunk_status_ == CHUNK_BODY)
+        if (chunk_status_ == CHUNK_BODY)
         {
+            size_t take = std::min(chunk_size_, end - pos);
+            if (!body_.append(data + pos, take))
+                return 500;
+            pos += take;
+            chunk_size_ -= take;
             if (chunk_size_ == 0)
-            {
-                if (!req_buffer_.empty())
-                    return parseChunkTrailer();
-                return 100; // Finished parsing chunked body and trailers
-            }
+                chunk_status_ = CHUNK_DATA_CR;
+            continue;
+        }
 
-            if (req_buffer_.size() >= chunk_size_)
+        char c = data[pos++];
+        switch (chunk_status_)
+        {
+        case CHUNK_SIZE:
+            if (hexDigit(c) >= 0)
             {
-                body_.append(req_buffer_, 0, chunk_size_);
-                req_buffer_.erase(0, chunk_size_ + 2);
-                chunk_size_ = 0;
-                chunk_status_ = CHUNK_SIZE;
+                // leading zeros keep the value small, the length is capped too
+                if (chunk_size_ > (std::numeric_limits<size_t>::max() >> 4) || ++chunk_line_ > CHUNK_LINE_MAX)
+                    return 400;
+                chunk_size_ = (chunk_size_ << 4) | hexDigit(c);
             }
+            else if (chunk_line_ == 0)
+                return 400;
+            else if (c == '\r')
+                chunk_status_ = CHUNK_SIZE_LF;
+            else if (c == ';' || c == ' ' || c == '\t')
+                chunk_status_ = CHUNK_EXTENSION;
             else
+                return 400;
+            break;
+        case CHUNK_EXTENSION:
+            if (c == '\r')
+                chunk_status_ = CHUNK_SIZE_LF;
+            else if (c == '\n' || ++chunk_line_ > CHUNK_LINE_MAX)
+                return 400;
+            break;
+        case CHUNK_SIZE_LF:
+            if (c != '\n')
+                return 400;
+            if ((status = chunkSizeLineDone()) != REQUEST_INCOMPLETE)
+                return status;
+            break;
+        case CHUNK_DATA_CR:
+            if (c != '\r')
+                return 400;
+            chunk_status_ = CHUNK_DATA_LF;
+            break;
+        case CHUNK_DATA_LF:
+            if (c != '\n')
+                return 400;
+            chunk_status_ = CHUNK_SIZE;
+            break;
+        case CHUNK_TRAILER:
+            if (c == '\r')
             {
-                // Chunk size larger than available data in buffer
-                body_.append(req_buffer_);
-                chunk_size_ -= req_buffer_.size();
-                req_buffer_.clear(); // Clear buffer after appending
+                chunk_status_ = CHUNK_END_LF;
+                break;
             }
+            if (c == ':' || c == '\n')
+                return 400;
+            chunk_status_ = CHUNK_TRAILER_NAME;
+            chunk_line_ = 1;
+            break;
+        case CHUNK_TRAILER_NAME:
+        case CHUNK_TRAILER_VALUE:
+            // trailer fields are checked for a name and dropped
+            if (c == '\n' || (c == '\r' && chunk_status_ == CHUNK_TRAILER_NAME))
+                return 400;
+            if (c == '\r')
+                chunk_status_ = CHUNK_TRAILER_LF;
+            else if (c == ':')
+                chunk_status_ = CHUNK_TRAILER_VALUE;
+            if (++chunk_line_ > CHUNK_LINE_MAX)
+                return 400;
+            if (++trailer_size_ > REQUEST_HEADERS_MAX)
+                return 431;
+            break;
+        case CHUNK_TRAILER_LF:
+            if (c != '\n')
+                return 400;
+            chunk_status_ = CHUNK_TRAILER;
+            break;
+        case CHUNK_END_LF:
+            if (c != '\n')
+                return 400;
+            parse_pos_ = pos;
+            return REQUEST_COMPLETE;
+        case CHUNK_BODY:
+            break;
         }
     }
-    return 200; // Incomplete chunk, need more data
+    parse_pos_ = pos;
+    return REQUEST_INCOMPLETE;
 }
 
-int HttpRequest::parseChunkSize(const std::string &hex)
+// End of a size line: the last chunk leads to the trailers, any other one
+// is refused as soon as it would cross client_max_body_size
+int HttpRequest::chunkSizeLineDone()
 {
-    // Convert hex chunk size to integer
-    std::istringstream hexStream(hex);
-    unsigned long tempChunkSize = 0;
-    hexStream >> std::hex >> tempChunkSize;
-    
-    if (hexStream.fail() || hexStream.bad())
-        return 400; // Bad Request: Invalid chunk size format
-
-    // Ensure tempChunkSize is within the range of size_t
-    if (tempChunkSize > static_cast<unsigned long>(std::numeric_limits<size_t>::max()))
-        return 400;
-    chunk_size_ = static_cast<size_t>(tempChunkSize);
-    return 0;
-}
-
-int HttpRequest::parseChunkTrailer()
-{
-    size_t end;
-    std::string line;
-
-    while ((end = req_buffer_.find("\r\n")) != std::string::npos)
+    chunk_line_ = 0;
+    if (chunk_size_ == 0)
     {
-        line = req_buffer_.substr(0, end);
-        req_buffer_.erase(0, end + 2);
-
-        // Check for an empty line, indicating the end of trailers
-        if (line.empty())
-        {
-            break;
-        }
-        size_t separatorPos = line.find(':');
-        if (separatorPos != std::string::npos)
-        {
-            std::string key = line.substr(0, separatorPos);
-            std::string value = line.substr(separatorPos + 1);
-
-            key = trim(key);
-            value = trim(value);
-            headers_[key] = value;
-        }
-        else
-        {
-            // If no separator found, it's an invalid format
-            return 400; // Bad Request: Invalid header format
-        }
+        chunk_status_ = CHUNK_TRAILER;
+        return REQUEST_INCOMPLETE;
     }
-
-    return 100;
+    if (max_body_size_ && chunk_size_ > max_body_size_ - body_.size())
+        return 413;
+    chunk_status_ = CHUNK_BODY;
+    return REQUEST_INCOMPLETE;
 }
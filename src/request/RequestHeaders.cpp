@@ -1,116 +1,102 @@
 #include "../../inc/HttpRequest.hpp"
+#include "../../inc/Scanner.hpp"
+#include <strings.h>
 
 /// @todo enforce certain header constraints specified in the RFC (e.g., no whitespace around the colon, no empty header keys).
 
+// Records each complete header line as slices of req_buffer_, lowercasing
+// the name in place; nothing is copied or erased
 int HttpRequest::parseHeaders() {
 
     size_t headerEnd;
-    size_t colonPos;
-    std::string headerKey;
-    std::string headerVal;
 
-    while ((headerEnd = req_buffer_.find("\r\n")) != std::string::npos) {
-        
-        if (req_buffer_.find("\r\n") == 0) { // if /r/n is in index 0 it would mean end of headers
-            req_buffer_.erase(0, headerEnd + 2);
+    while ((headerEnd = findLineEnd()) != std::string::npos) {
+        size_t start = parse_pos_;
+        parse_pos_ = headerEnd + 2;
+        if (parse_pos_ > REQUEST_HEADERS_MAX)
+            return 431;
+
+        if (headerEnd == start) { // an empty line ends the headers
+            head_end_ = parse_pos_;
             buffer_section_ = SPECIAL_HEADERS;
             break;
         }
 
-        // find headerKey
-        if ((colonPos = req_buffer_.find(':', 0)) != std::string::npos) {
-            if (colonPos == 0 || req_buffer_[colonPos - 1] == ' ')
-                return 400;
-            headerKey = trimmer(req_buffer_.substr(0, colonPos));
-            headerVal = trimmer(req_buffer_.substr(colonPos + 1, headerEnd - colonPos - 1));
-
-            std::transform(headerKey.begin(), headerKey.end(), headerKey.begin(), ::tolower);
-            
-            if (!isValidHeaderFormat(headerKey))
-                return 400;
-
-            headers_[headerKey] = headerVal;
-        } else {
+        // validates and lowercases the name in the same pass
+        size_t colonPos = start + Scanner::headerName(&req_buffer_[start], headerEnd - start);
+        if (colonPos == start || colonPos == headerEnd || req_buffer_[colonPos] != ':')
             return 400;
-        }
-        req_buffer_.erase(0, headerEnd + 2);
-    }
-
-    return 200;
-}
 
-bool HttpRequest::isValidHeaderFormat(const std::string& header) {
-    if (header.empty())
-        return false;
-
-    for (std::string::const_iterator it = header.begin(); it != header.end(); ++it) {
-        if (!isValidHeaderChar(*it)) {
-            return false;
-        }
+        size_t value = colonPos + 1;
+        size_t valueEnd = headerEnd;
+        while (value < valueEnd && (req_buffer_[value] == ' ' || req_buffer_[value] == '\t'))
+            value++;
+        while (valueEnd > value && (req_buffer_[valueEnd - 1] == ' ' || req_buffer_[valueEnd - 1] == '\t'))
+            valueEnd--;
+
+        if (header_count_ >= REQUEST_HEADERS_COUNT_MAX)
+            return 431;
+        header_count_++;
+        Header header = {start, colonPos - start, value, valueEnd - value};
+        HeaderId id = KnownHeaders::lookup(&req_buffer_[start], header.name_len);
+        if (id != HEADER_OTHER)
+            known_[id] = header; // a repeated field replaces the earlier one
+        else
+            others_.push_back(header);
     }
-    return true;
-}
-
-
-bool HttpRequest::isValidHeaderChar(unsigned char c) {
-    return (c >= 0x21 && c <= 0x7E) || ((c & 0x80) != 0 && c != 0x7F);
+    if (buffer_section_ == HEADERS && req_buffer_.size() > REQUEST_HEADERS_MAX)
+        return 431;
+    return REQUEST_INCOMPLETE;
 }
 
 int HttpRequest::checkSpecialHeaders() {
-    if (headers_.count("host")) {
-        std::string value = headers_["host"];
-        if (value.empty() || value.find('@') != std::string::npos) {
+    // 100-continue is the only expectation defined (RFC 9110 10.1.1)
+    const Header *expect = findHeader(HEADER_EXPECT);
+    if (expect && (expect->value_len != 12 || strncasecmp(&req_buffer_[expect->value], "100-continue", 12) != 0))
+        return 417;
+
+    const Header *host = findHeader(HEADER_HOST);
+    if (host) {
+        if (host->value_len == 0 || std::memchr(&req_buffer_[host->value], '@', host->value_len)) {
             std::cerr << "Invalid 'Host' header value." << std::endl;
             return 400;
         }
     }
 
-    if (headers_.count("transfer-encoding")) {
-        std::string value = headers_["transfer-encoding"];
-        if (value == "chunked") {
+    const Header *transferEncoding = findHeader(HEADER_TRANSFER_ENCODING);
+    const Header *contentLength = findHeader(HEADER_CONTENT_LENGTH);
+    if (transferEncoding) {
+        if (headerEquals(*transferEncoding, "chunked")) {
             isChunked_ = true;
             chunk_status_ = CHUNK_SIZE;
             buffer_section_ = CHUNK;
         } else {
             return 400;
         }
-    } else if (headers_.count("content-length")) {
-        std::string value = headers_["content-length"];
-        if (value.find_first_not_of("0123456789") != std::string::npos) {
+    } else if (contentLength) {
+        std::string value = headerValue(*contentLength);
+        if (value.empty() || value.find_first_not_of("0123456789") != std::string::npos) {
             std::cerr << "Invalid 'Content-Length' header value." << std::endl;
             return 400;
         }
-        try {
-            // Convert the value to an integer
-            std::istringstream iss(value); 
-            iss >> length_;
-        } catch (const std::exception& e) {
-            std::cerr << "Error parsing 'Content-Length' header: " << e.what() << std::endl;
-            return 400;
-        }
+        std::istringstream iss(value);
+        iss >> length_;
+        if (length_ == 0)
+            return REQUEST_COMPLETE;
         buffer_section_ = BODY;
     } else {
-        return 100;
+        return REQUEST_COMPLETE;
     }
 
-
-
-    if (headers_.count("method")) {
+    const Header *method = findHeader("method", 6);
+    if (method) {
         /// @todo this part needs to be thought through
-        std::string value = headers_["method"];
+        std::string value = headerValue(*method);
         if (value != "POST" && value != "PUT") {
             std::cerr << "Unsupported HTTP method: " << value << std::endl;
-            return 100;
+            return REQUEST_COMPLETE;
         }
     }
 
-    return 200;
-}
-
-std::string HttpRequest::trimmer(const std::string& str) {
-    size_t start = str.find_first_not_of(" \t");
-    size_t end = str.find_last_not_of(" \t");
-    return (start == std::string::npos || end == std::string::npos)
-        ? ""
-        : str.substr(start, end - start + 1);
+    return REQUEST_INCOMPLETE;
 }
@@ -1,38 +1,40 @@
 #include "../../inc/HttpRequest.hpp"
 
-int HttpRequest::extractRequestLineData(std::string requestLine)
+// Splits the request line [start, end) of req_buffer_
+int HttpRequest::extractRequestLineData(size_t start, size_t end)
 {
-    std::istringstream iss(requestLine);
     size_t methodEnd;
     size_t uriStart;
     size_t protocolStart;
 
-    methodEnd = requestLine.find(' ');
+    methodEnd = req_buffer_.find(' ', start);
     uriStart = methodEnd + 1;
-    protocolStart = requestLine.rfind(' ');
+    protocolStart = req_buffer_.rfind(' ', end - 1);
 
     // Check if both URI and protocol positions are valid
-    if (methodEnd == std::string::npos || protocolStart == std::string::npos || protocolStart <= uriStart)
+    if (methodEnd >= end || protocolStart == std::string::npos || protocolStart < start || protocolStart <= uriStart)
         return 400;
 
     // Extract METHOD, URI and Protocol
-    method_ = requestLine.substr(0, methodEnd);
-    uri_ = requestLine.substr(uriStart, protocolStart - uriStart);
-    (uri_.find("?") != std::string::npos) ? setTarget(uri_.substr(0, uri_.find("?"))) : setTarget(uri_);
-    protocol_ = requestLine.substr(protocolStart + 1);
+    method_ = Methods::lookup(req_buffer_.data() + start, methodEnd - start);
+    uri_.assign(req_buffer_, uriStart, protocolStart - uriStart);
+    protocol_.assign(req_buffer_, protocolStart + 1, end - protocolStart - 1);
     return 200;
 }
 
 int HttpRequest::parseRequestLine()
 {
+    size_t endOfFirstLine;
 
-    size_t endOfFirstLine = req_buffer_.find("\r\n");
+    // empty lines before a request are ignored (RFC 9112 2.2)
+    while ((endOfFirstLine = findLineEnd()) == parse_pos_)
+        parse_pos_ += 2;
     if (endOfFirstLine == std::string::npos)
-        return 400;
-
-    std::string requestLine = req_buffer_.substr(0, endOfFirstLine);
+        return (req_buffer_.size() - parse_pos_ > REQUEST_LINE_MAX) ? 414 : REQUEST_INCOMPLETE;
+    if (endOfFirstLine - parse_pos_ > REQUEST_LINE_MAX)
+        return 414;
 
-    int httpStatus = extractRequestLineData(requestLine);
+    int httpStatus = extractRequestLineData(parse_pos_, endOfFirstLine);
     if (httpStatus != 200)
         return httpStatus;
 
@@ -49,27 +51,15 @@ int HttpRequest::parseRequestLine()
         return httpStatus;
 
     buffer_section_ = HEADERS;
-    req_buffer_.erase(0, endOfFirstLine + 2);
+    parse_pos_ = endOfFirstLine + 2;
 
-    return 200;
+    return REQUEST_INCOMPLETE;
 }
 
+// Anything but a method the server knows, case included, is 501
 int HttpRequest::parseMethod()
 {
-    static const std::string validMethodsArray[] = {
-        "GET", "POST", "PUT", "DELETE", "PATCH", "OPTIONS", "HEAD", "TRACE", "CONNECT"};
-    static const std::set<std::string> validMethods(validMethodsArray, validMethodsArray + sizeof(validMethodsArray) / sizeof(validMethodsArray[0]));
-
-    // Check if the method is valid and in uppercase
-    if (validMethods.find(method_) == validMethods.end())
-        return 501;
-
-    for (std::string::const_iterator it = method_.begin(); it != method_.end(); ++it)
-    {
-        if (!isMethodCharValid(*it))
-            return 400;
-    }
-    return 200;
+    return method_ == METHOD_UNKNOWN ? 501 : 200;
 }
 
 void HttpRequest::parseSchemeAndAuthority(size_t schemeEnd, size_t &pathStart)
@@ -90,75 +80,129 @@ void HttpRequest::parseSchemeAndAuthority(size_t schemeEnd, size_t &pathStart)
     }
 }
 
-void HttpRequest::extractPathQueryFragment(size_t pathStart)
+// Byte classes of a request target, RFC 3986 3.3 to 3.5
+enum
 {
-    std::string decodedUri = decodeURIComponent(uri_);
+    URI_PATH = 1,     // pchar or '/', taken as is in the path
+    URI_QUERY = 2,    // taken as is in the query
+    URI_FRAGMENT = 4, // taken as is in the fragment
+};
 
-    size_t queryStart = decodedUri.find('?', pathStart);
-    size_t fragmentStart = decodedUri.find('#', pathStart);
+struct UriTable
+{
+    unsigned char cls[256];
+    signed char hex[256]; // value of a hex digit, -1 for other bytes
 
-    if (queryStart != std::string::npos)
+    UriTable()
     {
-        if (fragmentStart != std::string::npos && fragmentStart > queryStart)
-        {
-            path_ = decodedUri.substr(pathStart, queryStart - pathStart);
-            query_ = decodedUri.substr(queryStart + 1, fragmentStart - (queryStart + 1));
-            frag_ = decodedUri.substr(fragmentStart + 1);
-        }
-        else
+        for (int i = 0; i < 256; ++i)
         {
-            path_ = decodedUri.substr(pathStart, queryStart - pathStart);
-            query_ = decodedUri.substr(queryStart + 1);
+            char c = static_cast<char>(i);
+            cls[i] = 0;
+            hex[i] = -1;
+            if (isUnreserved(c) || isSubDelim(c) || c == ':' || c == '@' || c == '/')
+                cls[i] = URI_PATH | URI_QUERY | URI_FRAGMENT;
         }
+        cls['?'] = cls['['] = cls[']'] = URI_QUERY | URI_FRAGMENT;
+        cls['#'] = URI_FRAGMENT;
+        for (int c = '0'; c <= '9'; ++c)
+            hex[c] = c - '0';
+        for (int c = 'a'; c <= 'f'; ++c)
+            hex[c] = hex[c - 'a' + 'A'] = c - 'a' + 10;
     }
-    else if (fragmentStart != std::string::npos)
+};
+
+static const UriTable g_uri;
+
+// Ends the segment that starts at segment in path: "." is dropped, ".."
+// drops the segment before it as well. Returns false when ".." would climb
+// above the root.
+static bool closeSegment(std::string &path, size_t &segment, bool last)
+{
+    size_t len = path.size() - segment;
+    if (len == 1 && path[segment] == '.')
+        path.resize(segment);
+    else if (len == 2 && path[segment] == '.' && path[segment + 1] == '.')
     {
-        path_ = decodedUri.substr(pathStart, fragmentStart - pathStart);
-        frag_ = decodedUri.substr(fragmentStart + 1);
+        if (segment == 1)
+            return false;
+        segment = path.rfind('/', segment - 2) + 1;
+        path.resize(segment);
     }
-    else
+    else if (len > 0 && !last)
     {
-        path_ = decodedUri.substr(pathStart);
+        path += '/';
+        segment = path.size();
     }
+    return true;
+}
 
-    path_ = decodeURIComponent(path_);
-    query_ = decodeURIComponent(query_);
-    frag_ = decodeURIComponent(frag_);
+// Raw bytes of uri_ in [start, end) must all be of class cls or escapes
+static bool validRaw(const std::string &uri, size_t start, size_t end, unsigned char cls)
+{
+    for (size_t i = start; i < end; ++i)
+    {
+        unsigned char c = uri[i];
+        if (g_uri.cls[c] & cls)
+            continue;
+        if (c != '%' || end - i < 3 || g_uri.hex[(unsigned char)uri[i + 1]] < 0 || g_uri.hex[(unsigned char)uri[i + 2]] < 0)
+            return false;
+        i += 2;
+    }
+    return true;
 }
 
-std::string HttpRequest::decodeURIComponent(const std::string &str)
+// Splits uri_ from pathStart into path, query and fragment in one pass.
+// The path is percent-decoded and canonicalized on the way: repeated
+// slashes and "." segments go, ".." takes the segment before it along.
+// Query and fragment stay encoded, as QUERY_STRING expects them. A bad
+// escape, an encoded NUL, a byte outside RFC 3986 or a ".." above the root
+// gets 400.
+int HttpRequest::extractPathQueryFragment(size_t pathStart)
 {
-    std::string decoded;
-    for (size_t i = 0; i < str.length(); ++i)
+    size_t end = uri_.size();
+    size_t i = pathStart;
+    size_t segment = 1; // start of the last segment of path_
+
+    if (i < end && uri_[i] != '/' && uri_[i] != '?' && uri_[i] != '#')
+        return 400;
+    path_.assign(1, '/');
+    while (i < end && uri_[i] != '?' && uri_[i] != '#')
     {
-        if (str[i] == '%')
-        { // Percent-encoded sequence
-            if (i + 2 < str.length())
-            {
-                // Check if there are two hex characters following '%'
-                char hex1 = str[i + 1];
-                char hex2 = str[i + 2];
-                if (isxdigit(hex1) && isxdigit(hex2))
-                {
-                    int value;
-                    std::istringstream hexStream(str.substr(i + 1, 2));
-                    hexStream >> std::hex >> value; // Convert hex characters to integer value
-                    char decodedChar = static_cast<char>(value);
-                    decoded.append(&decodedChar, 1); // Append decoded character
-                    i += 2;                          // Move to next character
-                }
-                else
-                    decoded += str[i];
-            }
-            else
-                decoded += str[i];
+        unsigned char c = uri_[i++];
+        if (c == '%')
+        {
+            if (end - i < 2)
+                return 400;
+            int high = g_uri.hex[(unsigned char)uri_[i]];
+            int low = g_uri.hex[(unsigned char)uri_[i + 1]];
+            if (high < 0 || low < 0 || (high | low) == 0)
+                return 400;
+            c = high << 4 | low;
+            i += 2;
         }
-        else if (str[i] == '+')
-            decoded += ' ';
-        else
-            decoded += str[i];
+        else if (!(g_uri.cls[c] & URI_PATH))
+            return 400;
+        if (c != '/')
+            path_ += c;
+        else if (!closeSegment(path_, segment, false))
+            return 400;
     }
-    return decoded;
+    if (!closeSegment(path_, segment, true))
+        return 400;
+
+    size_t fragStart = uri_.find('#', i);
+    if (fragStart == std::string::npos)
+        fragStart = end;
+    if (i < fragStart && !validRaw(uri_, i + 1, fragStart, URI_QUERY))
+        return 400;
+    if (i < fragStart)
+        query_.assign(uri_, i + 1, fragStart - i - 1);
+    if (fragStart < end && !validRaw(uri_, fragStart + 1, end, URI_FRAGMENT))
+        return 400;
+    if (fragStart < end)
+        frag_.assign(uri_, fragStart + 1, std::string::npos);
+    return 200;
 }
 
 int HttpRequest::extractURIComponents()
@@ -168,14 +212,15 @@ int HttpRequest::extractURIComponents()
 
     pathStart = 0;
     schemeEnd = uri_.find(':');
-    if (schemeEnd != std::string::npos)
+    // absolute-form; a ':' in an origin-form path is just a path byte
+    if (uri_[0] != '/' && schemeEnd != std::string::npos)
     {
         parseSchemeAndAuthority(schemeEnd, pathStart);
     }
+    else if (uri_[0] != '/')
+        return 400;
 
-    extractPathQueryFragment(pathStart);
-
-    return (path_.empty() && uri_ != "/") ? 400 : 200;
+    return extractPathQueryFragment(pathStart);
 }
 
 bool HttpRequest::isValidScheme(const std::string &scheme)
@@ -272,99 +317,6 @@ int HttpRequest::isValidAuthority(const std::string &authority)
     return 200;
 }
 
-bool HttpRequest::isValidPath(const std::string &path)
-{
-    const std::string validPathChars = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-._~:/?#[]@!$&'()*+,;=";
-
-    if (path.empty() || path[0] != '/')
-    {
-        return false; // Path must start with '/'
-    }
-
-    for (size_t i = 0; i < path.length(); ++i)
-    {
-        char c = path[i];
-        if (isUnreserved(c) || isSubDelim(c) || c == ':' || c == '@' || c == '/')
-        {
-            continue; // Allowed characters
-        }
-        else if (c == '%' && i + 2 < path.length())
-        {
-            // Check percent-encoded characters
-            char hex1 = path[i + 1];
-            char hex2 = path[i + 2];
-            if (isHexDigit(hex1) && isHexDigit(hex2))
-            {
-                i += 2;
-                continue;
-            }
-        }
-        return false;
-    }
-
-    return true;
-}
-
-bool HttpRequest::isValidQuery(const std::string &query)
-{
-    if (query.empty())
-        return true;
-    const std::string validQueryChars = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-._~:/?#[]@!$&'()*+,;=";
-
-    for (size_t i = 0; i < query.length(); ++i)
-    {
-        char c = query[i];
-        if (isUnreserved(c) || isSubDelim(c) || c == ':' || c == '@' || c == '?' || c == '/' || c == '#' || c == '[' || c == ']' || c == '&' || c == '=' || c == '+' || c == '$' || c == ',' || c == ';')
-        {
-            continue; // Allowed characters
-        }
-        else if (c == '%' && i + 2 < query.length())
-        {
-            // Check percent-encoded characters
-            char hex1 = query[i + 1];
-            char hex2 = query[i + 2];
-            if (isHexDigit(hex1) && isHexDigit(hex2))
-            {
-                i += 2;
-                continue;
-            }
-        }
-        return false;
-    }
-
-    return true;
-}
-
-bool HttpRequest::isValidFragment(const std::string &fragment)
-{
-    if (fragment.empty())
-        return true;
-    const std::string validFragmentChars = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-._~:/?#[]@!$&'()*+,;=";
-
-    for (size_t i = 0; i < fragment.length(); ++i)
-    {
-        char c = fragment[i];
-        if (isUnreserved(c) || isSubDelim(c) || c == ':' || c == '@' || c == '?' || c == '/' || c == '#' || c == '[' || c == ']' || c == '&' || c == '=' || c == '+' || c == '$' || c == ',' || c == ';')
-        {
-            continue; // Allowed characters
-        }
-        else if (c == '%' && i + 2 < fragment.length())
-        {
-            // Check percent-encoded characters
-            char hex1 = fragment[i + 1];
-            char hex2 = fragment[i + 2];
-            if (isHexDigit(hex1) && isHexDigit(hex2))
-            {
-                i += 2;
-                continue;
-            }
-        }
-        return false;
-    }
-
-    return true;
-}
-
 void HttpRequest::setUriSuffix(std::string& uri) {
     std::string::size_type dotPos = uri.find('.');
     if (dotPos != std::string::npos) {
@@ -372,7 +324,6 @@ void HttpRequest::setUriSuffix(std::string& uri) {
         if (nextSlashPos != std::string::npos) {
             uri_suffix_ = uri.substr(nextSlashPos + 1);
             uri = uri.substr(0, nextSlashPos);
-            setTarget(uri);
         }
     }
 }
@@ -384,21 +335,15 @@ std::string HttpRequest::getUriSuffix() {
 
 int HttpRequest::validateURI()
 {
-    setUriSuffix(uri_);
-    if (uri_.empty())
-        return false;
-    int hasAuthority = extractURIComponents();
+    int httpStatus = extractURIComponents();
+    if (httpStatus != 200)
+        return httpStatus;
 
     if (!isValidScheme(scheme_))
         return 400;
-    if (hasAuthority == 200 && !isValidAuthority(authority_))
+    if (!scheme_.empty() && isValidAuthority(authority_) != 200)
         return 400;
-    if (!isValidPath(path_))
-        return 404;
-    if (!isValidQuery(query_))
-        return 405;
-    if (!isValidFragment(frag_))
-        return 406;
+    setUriSuffix(path_);
     return 200;
 }
 
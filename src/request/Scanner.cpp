@@ -0,0 +1,298 @@
+#include "../../inc/Scanner.hpp"
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define SCANNER_X86 // SSE2 is part of the baseline, AVX2 is checked at runtime
+#endif
+
+// Header name bytes end at ':' or at anything the old per-character check
+// rejected: controls, space and DEL. Bytes from 0x80 up are accepted.
+static inline bool endsName(unsigned char c)
+{
+    return c == ':' || c <= 0x20 || c == 0x7F;
+}
+
+static inline void lowerRange(char *data, size_t from, size_t to)
+{
+    for (size_t i = from; i < to; ++i)
+    {
+        if (data[i] >= 'A' && data[i] <= 'Z')
+            data[i] += 'a' - 'A';
+    }
+}
+
+// Index of the first CRLF at or after from, len when there is none. libc's
+// memchr is vectorized and unrolled, past a few blocks it beats our loops.
+static size_t lineEndScalar(const char *data, size_t from, size_t len)
+{
+    const char *p = data + from;
+    const char *end = data + len;
+
+    while ((p = static_cast<const char *>(std::memchr(p, '\n', end - p))))
+    {
+        if (p > data && p[-1] == '\r')
+            return p - 1 - data;
+        ++p;
+    }
+    return len;
+}
+
+static size_t headerNameScalar(char *data, size_t from, size_t len)
+{
+    for (size_t i = from; i < len; ++i)
+    {
+        if (endsName(data[i]))
+            return i;
+        if (data[i] >= 'A' && data[i] <= 'Z')
+            data[i] += 'a' - 'A';
+    }
+    return len;
+}
+
+#ifdef SCANNER_X86
+
+#define SCANNER_INLINE static inline __attribute__((always_inline))
+#define SCANNER_SHORT_LINE 128 // bytes scanned in blocks, the rest of a longer line goes to memchr
+
+// A LF found in a block only ends a line when a CR precedes it
+SCANNER_INLINE size_t firstCrlf(const char *data, size_t base, unsigned mask)
+{
+    while (mask)
+    {
+        size_t pos = base + __builtin_ctz(mask);
+        if (pos > 0 && data[pos - 1] == '\r')
+            return pos - 1;
+        mask &= mask - 1;
+    }
+    return static_cast<size_t>(-1);
+}
+
+// The 16 byte steps are inlined into the AVX2 functions as well, so those
+// never switch to legacy SSE encoding for their tails
+
+SCANNER_INLINE unsigned lfMask16(const char *data)
+{
+    __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(block, _mm_set1_epi8('\n')));
+}
+
+// Signed compares: 0x21..0x7F are > 0x20, bytes from 0x80 are < 0
+SCANNER_INLINE unsigned nameStopMask16(const char *data)
+{
+    __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+    __m128i zero = _mm_setzero_si128();
+    __m128i visible = _mm_or_si128(_mm_cmpgt_epi8(block, _mm_set1_epi8(0x20)), _mm_cmplt_epi8(block, zero));
+    __m128i stop = _mm_or_si128(_mm_cmpeq_epi8(visible, zero),
+                                _mm_or_si128(_mm_cmpeq_epi8(block, _mm_set1_epi8(0x7F)), _mm_cmpeq_epi8(block, _mm_set1_epi8(':'))));
+    return _mm_movemask_epi8(stop);
+}
+
+SCANNER_INLINE void lower16(char *data)
+{
+    __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+    __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(block, _mm_set1_epi8('A' - 1)), _mm_cmplt_epi8(block, _mm_set1_epi8('Z' + 1)));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(data), _mm_add_epi8(block, _mm_and_si128(upper, _mm_set1_epi8(0x20))));
+}
+
+// Scans [i, len) in 16 byte steps. A last partial block is read again
+// from len - 16 when the span allows it, ignoring the bytes before i.
+SCANNER_INLINE size_t lineEndTail16(const char *data, size_t from, size_t i, size_t len)
+{
+    for (; i + 16 <= len; i += 16)
+    {
+        size_t pos = firstCrlf(data, i, lfMask16(data + i));
+        if (pos != static_cast<size_t>(-1))
+            return pos;
+    }
+    if (i == len)
+        return len;
+    if (len - from < 16)
+        return lineEndScalar(data, i, len);
+    size_t base = len - 16;
+    size_t pos = firstCrlf(data, base, lfMask16(data + base) & (~0u << (i - base)));
+    return pos != static_cast<size_t>(-1) ? pos : len;
+}
+
+SCANNER_INLINE size_t headerNameTail16(char *data, size_t from, size_t i, size_t len)
+{
+    for (; i + 16 <= len; i += 16)
+    {
+        unsigned mask = nameStopMask16(data + i);
+        if (mask)
+        {
+            size_t pos = i + __builtin_ctz(mask);
+            lowerRange(data, i, pos);
+            return pos;
+        }
+        lower16(data + i);
+    }
+    if (i == len)
+        return len;
+    if (len - from < 16)
+        return headerNameScalar(data, i, len);
+    // the bytes before i are name bytes already lowercased, so redoing them is harmless
+    size_t base = len - 16;
+    unsigned mask = nameStopMask16(data + base) & (~0u << (i - base));
+    if (!mask)
+    {
+        lower16(data + base);
+        return len;
+    }
+    size_t pos = base + __builtin_ctz(mask);
+    lowerRange(data, i, pos);
+    return pos;
+}
+
+static size_t lineEndSse2(const char *data, size_t from, size_t len)
+{
+    if (len - from <= SCANNER_SHORT_LINE)
+        return lineEndTail16(data, from, from, len);
+    size_t stop = from + SCANNER_SHORT_LINE;
+    size_t pos = lineEndTail16(data, from, from, stop);
+    return pos < stop ? pos : lineEndScalar(data, stop, len);
+}
+
+static size_t headerNameSse2(char *data, size_t from, size_t len)
+{
+    return headerNameTail16(data, from, from, len);
+}
+
+__attribute__((target("avx2"))) static size_t lineEndAvx2(const char *data, size_t from, size_t len)
+{
+    const __m256i lf = _mm256_set1_epi8('\n');
+    size_t i = from;
+    size_t stop = len - from > SCANNER_SHORT_LINE ? from + SCANNER_SHORT_LINE : len;
+
+    for (; i + 32 <= stop; i += 32)
+    {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+        size_t pos = firstCrlf(data, i, _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, lf)));
+        if (pos != static_cast<size_t>(-1))
+            return pos;
+    }
+    if (stop < len)
+        return lineEndScalar(data, i, len);
+    return lineEndTail16(data, from, i, len);
+}
+
+__attribute__((target("avx2"))) static size_t headerNameAvx2(char *data, size_t from, size_t len)
+{
+    const __m256i space = _mm256_set1_epi8(0x20);
+    const __m256i del = _mm256_set1_epi8(0x7F);
+    const __m256i colon = _mm256_set1_epi8(':');
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i beforeA = _mm256_set1_epi8('A' - 1);
+    const __m256i afterZ = _mm256_set1_epi8('Z' + 1);
+    const __m256i caseBit = _mm256_set1_epi8(0x20);
+    size_t i = from;
+
+    for (; i + 32 <= len; i += 32)
+    {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+        __m256i visible = _mm256_or_si256(_mm256_cmpgt_epi8(block, space), _mm256_cmpgt_epi8(zero, block));
+        __m256i stop = _mm256_or_si256(_mm256_cmpeq_epi8(visible, zero),
+                                       _mm256_or_si256(_mm256_cmpeq_epi8(block, del), _mm256_cmpeq_epi8(block, colon)));
+        unsigned mask = _mm256_movemask_epi8(stop);
+        if (mask)
+        {
+            size_t pos = i + __builtin_ctz(mask);
+            lowerRange(data, i, pos);
+            return pos;
+        }
+        __m256i upper = _mm256_and_si256(_mm256_cmpgt_epi8(block, beforeA), _mm256_cmpgt_epi8(afterZ, block));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(data + i), _mm256_add_epi8(block, _mm256_and_si256(upper, caseBit)));
+    }
+    return headerNameTail16(data, from, i, len);
+}
+
+#endif
+
+struct ScannerImpl
+{
+    Scanner::Level level;
+    size_t (*lineEnd)(const char *, size_t, size_t);
+    size_t (*headerName)(char *, size_t, size_t);
+};
+
+static bool supported(Scanner::Level level)
+{
+#ifdef SCANNER_X86
+    if (level == Scanner::AVX2)
+        return __builtin_cpu_supports("avx2");
+    if (level == Scanner::SSE2)
+        return __builtin_cpu_supports("sse2");
+#endif
+    return level == Scanner::SCALAR;
+}
+
+static ScannerImpl implFor(Scanner::Level level)
+{
+    ScannerImpl impl = {Scanner::SCALAR, lineEndScalar, headerNameScalar};
+#ifdef SCANNER_X86
+    if (level == Scanner::AVX2)
+    {
+        impl.level = level;
+        impl.lineEnd = lineEndAvx2;
+        impl.headerName = headerNameAvx2;
+    }
+    else if (level == Scanner::SSE2)
+    {
+        impl.level = level;
+        impl.lineEnd = lineEndSse2;
+        impl.headerName = headerNameSse2;
+    }
+#endif
+    return impl;
+}
+
+static ScannerImpl detect()
+{
+#ifdef SCANNER_X86
+    __builtin_cpu_init(); // may run before the constructors that would call it
+#endif
+    if (supported(Scanner::AVX2))
+        return implFor(Scanner::AVX2);
+    if (supported(Scanner::SSE2))
+        return implFor(Scanner::SSE2);
+    return implFor(Scanner::SCALAR);
+}
+
+// Chosen during static initialisation, before any event loop thread starts
+static ScannerImpl g_impl = detect();
+
+// Index of the first CRLF in data, len when there is none
+size_t Scanner::lineEnd(const char *data, size_t len)
+{
+    return g_impl.lineEnd(data, 0, len);
+}
+
+// Index of the ':' or invalid byte ending a header name, len when there is
+// none. The name bytes before it are lowercased in place.
+size_t Scanner::headerName(char *data, size_t len)
+{
+    return g_impl.headerName(data, 0, len);
+}
+
+Scanner::Level Scanner::level()
+{
+    return g_impl.level;
+}
+
+// Forces a level, for benchmarks. Fails when the CPU lacks it.
+bool Scanner::setLevel(Level level)
+{
+    if (!supported(level))
+        return false;
+    g_impl = implFor(level);
+    return true;
+}
+
+const char *Scanner::levelName(Level level)
+{
+    if (level == AVX2)
+        return "avx2";
+    if (level == SSE2)
+        return "sse2";
+    return "scalar";
+}
@@ -1,21 +1,49 @@
 #include "../../inc/AllHeaders.hpp"
+#include "../../inc/Arena.hpp"
 
-Client::Client(DB &db, Listen &host_port, HttpRequest &req_, size_t targetServerIdx, int status) : request_(&req_), host_port_(host_port), config_(NULL), response_(NULL), db_(db), serverId_(targetServerIdx), statusCode_(status)
+Client::Client(const ConfigSnapshot &snapshot, Listen &host_port, HttpRequest &req_, size_t targetServerIdx, int status, Arena &arena) : request_(&req_), host_port_(host_port), config_(NULL), response_(NULL), arena_(arena), snapshot_(snapshot), serverId_(targetServerIdx), statusCode_(status), keepAlive_(false)
 {
   setupConfig();
 }
 
+// The arena only takes the memory back on the connection's next request
 Client::~Client()
 {
-  delete config_;
+  destroyResponse();
+  if (config_)
+    config_->~RequestConfig();
 }
 
 void Client::setupConfig()
 {
-  config_ = new RequestConfig(*request_, host_port_, db_, *this);
+  config_ = ARENA_NEW(arena_, RequestConfig)(*request_, host_port_, snapshot_, *this);
   config_->setUp(serverId_);
 }
-std::string Client::getResponseString()
+
+void Client::destroyResponse()
+{
+  if (response_)
+    response_->~HttpResponse();
+  response_ = NULL;
+}
+// The refusals HttpResponse::build would make that need only the headers,
+// so a request the location turns down is answered before its body is
+// read. REQUEST_INCOMPLETE lets the request go on.
+int Client::checkHeaders()
+{
+  size_t maxBody = config_->getClientMaxBodySize();
+
+  if (!config_->isMethodAccepted(config_->getMethod()))
+    return 405;
+  if (maxBody > 0 && request_->getContentLength() > maxBody)
+    return 413;
+  if (config_->getAuth() != "off" && !config_->checkAuth())
+    return 401;
+  request_->setMaxBodySize(maxBody); // chunked bodies are checked as they grow
+  return REQUEST_INCOMPLETE;
+}
+
+std::string &Client::getResponseString()
 {
   return response_->getSampleResponse();
 }
@@ -28,7 +56,8 @@ void Client::setupResponse()
   if (!config_)
     setupConfig();
 
-  response_ = new HttpResponse(*config_, statusCode_);
+  response_ = ARENA_NEW(arena_, HttpResponse)(*config_, arena_, statusCode_);
+  response_->setKeepAlive(keepAlive_);
 
   int loop = 0;
 
@@ -46,12 +75,9 @@ void Client::setupResponse()
     }
     if (loop >= 10)
     {
-      if (response_)
-      {
-        delete response_;
-        response_ = NULL;
-      }
-      response_ = new HttpResponse(*config_, 500);
+      destroyResponse();
+      response_ = ARENA_NEW(arena_, HttpResponse)(*config_, arena_, 500);
+      response_->setKeepAlive(keepAlive_);
       response_->build();
       break;
     }
@@ -61,6 +87,16 @@ void Client::setupResponse()
 
 }
 
+void Client::setKeepAlive(bool keepAlive)
+{
+  keepAlive_ = keepAlive;
+}
+
+bool Client::shouldDisconnect()
+{
+  return !response_ || response_->shouldDisconnect();
+}
+
 HttpRequest *Client::getRequest(bool val) {
   if (!request_ && val)
     request_ = new HttpRequest();
@@ -36,7 +36,7 @@ void HttpResponse::setErrorPageHeaders(int status_code)
 
 void HttpResponse::redirectToErrorPage(const std::string &target, int status_code)
 {
-    config_.getMethod() = "GET";
+    config_.setMethod(METHOD_GET);
 
     redirect_ = true;
     redirect_code_ = status_code;
@@ -46,10 +46,10 @@ void HttpResponse::redirectToErrorPage(const std::string &target, int status_cod
 int HttpResponse::checkCustomErrorPage(int status_code)
 {
 
-    const std::string &customErrorPage = config_.getErrorPages()[status_code];
-    if (!customErrorPage.empty())
+    std::map<int, std::string>::const_iterator customErrorPage = config_.getErrorPages().find(status_code);
+    if (customErrorPage != config_.getErrorPages().end() && !customErrorPage->second.empty())
     {
-        std::string target = removeDupSlashes(customErrorPage);
+        std::string target = removeDupSlashes(customErrorPage->second);
         std::string cur_target = removeDupSlashes("/" + config_.getTarget());
 
         if (target != cur_target)
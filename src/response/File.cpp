@@ -1,8 +1,8 @@
 #include "../../inc/File.hpp"
 
-File::File() : fd_(0) {}
+File::File() : fd_(-1) {}
 
-File::File(std::string path) : fd_(0)
+File::File(std::string path) : fd_(-1)
 {
     set_path(path);
 }
@@ -12,9 +12,9 @@ File::~File()
     closeFile();
 }
 
-void File::set_path(std::string path, bool negotiation)
+void File::set_path(const std::string &path, bool negotiation)
 {
-    path_ = removeDupSlashes(path);
+    removeDupSlashes(path).swap(path_);
 
     (negotiation) ? parseExtNegotiation() : parseExt();
 }
@@ -87,17 +87,19 @@ void File::parseExtNegotiation()
                      : file;
 }
 
-void File::createFile(const std::string &body)
+// Streams the request body into the file, whether it is in memory or spilled
+void File::createFile(const BodyBuffer &body)
 {
-    ssize_t bytes_written = write(fd_, body.c_str(), body.length());
-    if (bytes_written <= 0)
+    if (fd_ < 0 && !openFile(true))
+        return;
+    if (!body.writeTo(fd_))
     {
         std::string errorStr = "write: ";
         errorStr += strerror(errno);
         std::cout << "Error: " << errorStr << std::endl;
     }
 
-    close(fd_);
+    closeFile();
 }
 
 std::string File::getMimeType(const std::string ext)
@@ -114,7 +116,7 @@ std::string File::getStatusCode(int code)
 
 bool File::openFile(bool create)
 {
-    close(fd_);
+    closeFile();
 
     int flags = create ? (O_CREAT | O_RDWR | O_TRUNC) : O_RDONLY;
     fd_ = open(path_.c_str(), flags, 0755);
@@ -132,7 +134,7 @@ bool File::openFile(bool create)
 
 void File::closeFile()
 {
-    if (fd_ <= 0)
+    if (fd_ < 0)
         return;
     std::cout << "Closing file: " << path_ << std::endl;
     close(fd_);
@@ -168,7 +170,7 @@ void File::appendFile(const std::string &body)
     closeFile();
 }
 
-void File::appendFile(const std::string &body,std::string ext)
+void File::appendFile(const BodyBuffer &body,std::string ext)
 {
     int flags = O_CREAT | O_WRONLY | O_TRUNC;
     std::string dirPath = "www";
@@ -189,8 +191,7 @@ void File::appendFile(const std::string &body,std::string ext)
         return;
     }
 
-    ssize_t bytes_written = write(fd_, body.c_str(), body.length());
-    if (bytes_written <= 0)
+    if (!body.writeTo(fd_))
     {
         std::cerr << "Error appending to file: " << strerror(errno) << std::endl;
     }
@@ -354,9 +355,10 @@ directory_listing File::createListing(const std::string &fileName, const std::st
     listing.is_dir_ = S_ISDIR(fileStat.st_mode);
     listing.size_ = fileStat.st_size;
 
-    struct tm *timeinfo = localtime(&fileStat.st_mtime);
+    struct tm timeinfo;
+    localtime_r(&fileStat.st_mtime, &timeinfo);
     char dateBuf[20];
-    strftime(dateBuf, sizeof(dateBuf), "%d-%b-%Y %H:%M", timeinfo);
+    strftime(dateBuf, sizeof(dateBuf), "%d-%b-%Y %H:%M", &timeinfo);
     listing.date_ = std::string(dateBuf);
 
     return listing;
@@ -416,7 +418,7 @@ void File::print_file_info(const std::string &file) const
         std::cout << "Failed to get information for " << filename << std::endl;
 }
 
-std::string File::find_index(std::vector<std::string> &indexes)
+std::string File::find_index(const std::vector<std::string> &indexes)
 {
     DIR *dir;
     struct dirent *ent;
@@ -477,31 +479,37 @@ std::vector<std::string> &File::getMatches()
     return matches_;
 }
 
-std::string File::getContent()
+// Reads the whole file straight into content, sized once from fstat
+bool File::getContent(std::string &content)
 {
-    std::ifstream fileStream(path_.c_str(), std::ios::binary);
-    if (!fileStream.is_open())
+    struct stat fileStat;
+    int fd = open(path_.c_str(), O_RDONLY);
+
+    content.clear();
+    if (fd < 0 || fstat(fd, &fileStat) != 0)
     {
         std::cerr << "Failed to open file: " << path_ << std::endl;
-        return "";
+        if (fd >= 0)
+            close(fd);
+        return false;
     }
-
-    // Get the size of the file for proper buffer allocation
-    fileStream.seekg(0, std::ios::end);
-    std::streamsize fileSize = fileStream.tellg();
-    fileStream.seekg(0, std::ios::beg);
-
-    std::vector<char> buffer(fileSize);
-
-  
-    if (!fileStream.read(buffer.data(), fileSize))
+    content.resize(fileStat.st_size);
+    size_t done = 0;
+    while (done < content.size())
+    {
+        ssize_t bytes = read(fd, &content[done], content.size() - done);
+        if (bytes <= 0)
+            break;
+        done += bytes;
+    }
+    close(fd);
+    content.resize(done);
+    if (done < static_cast<size_t>(fileStat.st_size))
     {
         std::cerr << "Error reading file into buffer: " << path_ << std::endl;
-        return "";
+        return false;
     }
-    std::string content(buffer.begin(), buffer.end());
-
-    return content;
+    return true;
 }
 
 int &File::getFd()
@@ -1,26 +1,29 @@
 #include "../../inc/HttpResponse.hpp"
+#include <csignal>
 
-HttpResponse::HttpResponse(RequestConfig &config, int error_code) : config_(config), error_code_(error_code)
+HttpResponse::HttpResponse(RequestConfig &config, Arena &arena, int error_code) : config_(config), arena_(arena), file_(NULL), error_code_(error_code), headers_(std::less<std::string>(), ArenaAllocator<std::pair<const std::string, std::string> >(arena))
 {
 	status_code_ = 0;
-	total_sent_ = 0;
 	header_size_ = 0;
 	body_size_ = 0;
 	redirect_code_ = 0;
 	redirect_ = false;
+	keep_alive_ = false;
 	charset_ = "";
 	cgiHeadersParsed_ = false;
 	cgiRead = false;
-	initMethods();
 }
 
-HttpResponse::~HttpResponse() {}
+HttpResponse::~HttpResponse()
+{
+	if (file_)
+		file_->~File();
+}
 
 void HttpResponse::cleanUp()
 {
 	error_code_ = 0;
 	status_code_ = 0;
-	total_sent_ = 0;
 	header_size_ = 0;
 	body_size_ = 0;
 	redirect_ = false;
@@ -31,7 +34,7 @@ void HttpResponse::cleanUp()
 	headers_.clear();
 	if (file_)
 	{
-		delete file_;
+		file_->~File();
 		file_ = NULL;
 	}
 }
@@ -41,59 +44,54 @@ bool HttpResponse::shouldDisconnect()
 	return headers_.find("Connection") != headers_.end() && headers_["Connection"] == "close";
 }
 
-void HttpResponse::printMethodMap()
+void HttpResponse::setKeepAlive(bool keepAlive)
 {
-	std::map<std::string, int (HttpResponse::*)()>::iterator it;
-
-	for (it = methods_.begin(); it != methods_.end(); ++it)
-	{
-		std::cout << "Method: " << it->first << ", Function Pointer: " << it->second << std::endl;
-	}
+	keep_alive_ = keepAlive;
 }
 
-void HttpResponse::initMethods()
+// Handler per HttpMethod, NULL for the ones the server does not implement
+static const HttpResponse::type g_handlers[METHOD_COUNT] = {
+	&HttpResponse::GET,    // GET
+	&HttpResponse::GET,    // HEAD
+	&HttpResponse::POST,   // POST
+	&HttpResponse::PUT,    // PUT
+	&HttpResponse::DELETE, // DELETE
+	NULL,                  // PATCH
+	NULL,                  // OPTIONS
+	NULL,                  // TRACE
+	NULL,                  // CONNECT
+};
+
+void HttpResponse::printMethodMap()
 {
-	methods_["GET"] = &HttpResponse::GET;
-	methods_["HEAD"] = &HttpResponse::GET;
-	methods_["POST"] = &HttpResponse::POST;
-	methods_["PUT"] = &HttpResponse::PUT;
-	methods_["DELETE"] = &HttpResponse::DELETE;
+	for (int m = 0; m < METHOD_COUNT; ++m)
+	{
+		if (g_handlers[m])
+			std::cout << "Method: " << Methods::name(static_cast<HttpMethod>(m)) << ", Function Pointer: " << g_handlers[m] << std::endl;
+	}
 }
 
-void HttpResponse::buildDebugger(std::string method)
+void HttpResponse::buildDebugger(HttpMethod method)
 {
-	std::cout << "Method: " << method << std::endl;
+	std::cout << "Method: " << Methods::name(method) << std::endl;
 	std::cout << "file path: " << file_->getFilePath() << std::endl;
 	std::cout << "Error code: " << error_code_ << std::endl;
 	std::cout << "Accepted: " << config_.isMethodAccepted(method) << std::endl;
 	std::cout << "MethodList: " << buildMethodList() << std::endl;
 	std::cout << "Max body size: " << config_.getClientMaxBodySize() << std::endl;
-	std::cout << "Body size: " << config_.getBody().length() << std::endl;
+	std::cout << "Body size: " << config_.getBody().size() << std::endl;
 	std::cout << "Auth: " << config_.getAuth() << std::endl;
-	std::cout << "CheckAuth: " << checkAuth() << std::endl;
+	std::cout << "CheckAuth: " << config_.checkAuth() << std::endl;
 	std::cout << "HandleMethods: " << handleMethods() << std::endl;
 	std::cout << "BuildErrorPage: " << buildErrorPage(status_code_) << std::endl;
 }
 
-std::pair<std::string, int> HttpResponse::findLocation(std::string target)
-{
-	std::map<std::string, int> locationsMap = config_.getLocationsMap();
-	for (std::map<std::string, int>::iterator it = locationsMap.begin(); it != locationsMap.end(); ++it)
-	{
-		if (target == it->first)
-			return *it;
-	}
-	return std::make_pair("", 0);
-}
-
 void HttpResponse::build()
 {
-	if (config_.getLociMatched() == 404)
-		error_code_ = 404;
-	std::string &method = config_.getMethod();
-	file_ = new File();
+	HttpMethod method = config_.getMethod();
+	file_ = ARENA_NEW(arena_, File)();
 
-	if (findLocation(config_.getTarget()).first != "")
+	if (config_.getServer().find(config_.getTarget()))
 	{
 		config_.setTarget("/");
 		config_.setUri("/");
@@ -101,18 +99,21 @@ void HttpResponse::build()
 
 	file_->set_path(config_.getRoot() + "/" + config_.getTarget());
 
-	bool isAuthorized = config_.getAuth() != "off" && !checkAuth();
+	bool isAuthorized = config_.getAuth() != "off" && !config_.checkAuth();
 
   if (error_code_ > 200) {
 
     status_code_ = error_code_;
+    // refused before the body was read, see Client::checkHeaders
+    if (status_code_ == 405)
+      headers_["Allow"] = buildMethodList();
   }
   else if (!config_.isMethodAccepted(method))
   {
     status_code_ = 405;
     headers_["Allow"] = buildMethodList();
   }
-  else if (config_.getClientMaxBodySize() > 0 && config_.getBody().length() > config_.getClientMaxBodySize())
+  else if (config_.getClientMaxBodySize() > 0 && config_.getBody().size() > config_.getClientMaxBodySize())
   {
     status_code_ = 413;
   }
@@ -132,9 +133,9 @@ void HttpResponse::build()
 
 int HttpResponse::handleMethods()
 {
-	std::string &method = config_.getMethod();
+	HttpMethod method = config_.getMethod();
 
-	if (method == "GET" || method == "HEAD")
+	if (method == METHOD_GET || method == METHOD_HEAD)
 	{
 		if (file_->is_directory())
 		{
@@ -158,16 +159,17 @@ int HttpResponse::handleMethods()
 		return status_code_;
 	}
 
-	if (method == "PUT" || method == "POST")
+	if (method == METHOD_PUT || method == METHOD_POST)
 		handlePutPostRequest();
 
-	return (this->*(HttpResponse::methods_[method]))();
+	if (!g_handlers[method])
+		return handleOtherMethods();
+	return (this->*g_handlers[method])();
 }
 
 int HttpResponse::handleDirectoryRequest()
 {
-	std::vector<std::string> indexes = config_.getIndexes();
-	std::string index = file_->find_index(indexes);
+	std::string index = file_->find_index(config_.getIndexes());
 	std::string newPath;
 
 	if (!index.empty())
@@ -185,20 +187,24 @@ int HttpResponse::handleDirectoryRequest()
 
 int HttpResponse::handleFileRequest()
 {
-	std::string path = file_->getFilePath();
-
 	if (!file_->exists())
 		return 404;
 
-	file_->findMatchingFiles();
-	std::vector<std::string> &matches = file_->getMatches();
-	handleAcceptLanguage(matches);
-	handleAcceptCharset(matches);
+	// the directory is only listed when there is something to negotiate
+	if (config_.hasHeader(HEADER_ACCEPT_LANGUAGE) || config_.hasHeader(HEADER_ACCEPT_CHARSET))
+	{
+		file_->findMatchingFiles();
+		std::vector<std::string> &matches = file_->getMatches();
+		handleAcceptLanguage(matches);
+		handleAcceptCharset(matches);
+	}
 
 	if (!file_->openFile())
 		return 403;
 
-	headers_["Last-Modified"] = file_->last_modified();
+	// swapped in, assigning the returned string would copy it once more
+	std::string modified = file_->last_modified();
+	headers_["Last-Modified"].swap(modified);
 
 	return 0;
 }
@@ -236,7 +242,7 @@ void HttpResponse::handleAcceptLanguage(std::vector<std::string> &matches)
 {
 	std::string path = file_->getFilePath();
 
-	if (!config_.getHeader("Accept-Language").empty())
+	if (config_.hasHeader(HEADER_ACCEPT_LANGUAGE))
 	{
 		if (localization(matches))
 			file_->set_path(path.substr(0, path.find_last_of("/") + 1) + matches.front(), true);
@@ -247,43 +253,25 @@ void HttpResponse::handleAcceptCharset(std::vector<std::string> &matches)
 {
 	std::string path = file_->getFilePath();
 
-	if (!config_.getHeader("Accept-Charset").empty())
+	if (config_.hasHeader(HEADER_ACCEPT_CHARSET))
 	{
 		charset_ = accept_charset(matches);
 		file_->set_path(path.substr(0, path.find_last_of("/") + 1) + matches.front(), true);
 	}
 }
 
+// Allowed by the location but without a handler, a 405 still names the
+// methods that work (RFC 9110 15.5.6)
 int HttpResponse::handleOtherMethods()
 {
 	std::cerr << "Method not implemented" << std::endl;
+	headers_["Allow"] = buildMethodList();
 	return 405;
 }
 
-bool HttpResponse::checkAuth()
+const std::string &HttpResponse::buildMethodList()
 {
-	std::string authCredentials = config_.getHeader("Authorization");
-	if (authCredentials.empty())
-		return false;
-	std::string token = b64decode(authCredentials.substr(authCredentials.find(' ') + 1));
-	return (token == config_.getAuth());
-}
-
-std::string HttpResponse::buildMethodList()
-{
-	std::string list;
-	std::vector<std::string> methods = config_.getMethods();
-
-	std::vector<std::string>::iterator it = methods.begin();
-
-	while (it != methods.end())
-	{
-		list += *it;
-		it++;
-		if (it != methods.end())
-			list += ", ";
-	}
-	return list;
+	return Methods::allowHeader(config_.getMethods() & METHODS_IMPLEMENTED);
 }
 
 std::string HttpResponse::response_log(LogLevel level)
@@ -319,7 +307,7 @@ bool HttpResponse::getRedirect()
 	return redirect_;
 }
 
-std::string HttpResponse::redirect_target()
+const std::string &HttpResponse::redirect_target()
 {
 	return redirect_target_;
 }
@@ -328,7 +316,13 @@ void HttpResponse::createResponse()
 {
 	headers_["Server"] = "webserv/1.1";
 
-	if (config_.getMethod() == "HEAD")
+	// a persistent connection needs the length to find the end of the body
+	if (!headers_.count("Content-Length") && status_code_ >= 200 && status_code_ != 204 && status_code_ != 304)
+		headers_["Content-Length"] = ftos(body_.length());
+	if (!headers_.count("Connection"))
+		headers_["Connection"] = keep_alive_ ? "keep-alive" : "close";
+
+	if (config_.getMethod() == METHOD_HEAD)
 	{
 		body_.clear();
 	}
@@ -339,64 +333,44 @@ void HttpResponse::createResponse()
 	}
 
 	std::string status_code_phrase = file_->getStatusCode(status_code_);
-	std::string status_line = "HTTP/1.1 " + ftos(status_code_) + " " + status_code_phrase + "\r\n";
-
-	headers_["Date"] = get_http_date();
-
-	std::string header_block;
-	for (std::map<std::string, std::string>::iterator it = headers_.begin(); it != headers_.end(); it++)
-	{
-		header_block += it->first + ": " + it->second + "\r\n";
-	}
+	std::string status_code = ftos(status_code_);
 
-	header_block += "\r\n"; // add empty line after headers
+	std::string date = get_http_date();
+	headers_["Date"].swap(date);
 
-	// Concatenate status line, headers, and body
-	response_ = status_line + header_block + body_;
+	// sized up front so the whole response is written into one allocation
+	size_t size = 9 + status_code.size() + 1 + status_code_phrase.size() + 2 + 2 + body_.size();
+	for (ArenaMap<std::string, std::string>::type::iterator it = headers_.begin(); it != headers_.end(); it++)
+		size += it->first.size() + 2 + it->second.size() + 2;
 
-	// Calculate header and body sizes
-	header_size_ = status_line.size() + header_block.size();
+	response_.clear();
+	response_.reserve(size);
+	response_.append("HTTP/1.1 ").append(status_code).append(" ").append(status_code_phrase).append("\r\n");
+	for (ArenaMap<std::string, std::string>::type::iterator it = headers_.begin(); it != headers_.end(); it++)
+		response_.append(it->first).append(": ").append(it->second).append("\r\n");
+	response_.append("\r\n"); // add empty line after headers
+
+	header_size_ = response_.size();
+	response_.append(body_);
 	body_size_ = body_.size();
 	body_.clear();
 	// std::cout << "RESPONSE: " << response_ << std::endl;
 }
 
-std::string HttpResponse::getSampleResponse()
+// The response itself, Servers hands it to the Connection without a copy
+std::string &HttpResponse::getSampleResponse()
 {
 	return response_;
 }
 
-int HttpResponse::sendResponse(int fd)
-{
-	std::string fullResponse = response_;
-	if (!body_.empty())
-	{
-		headers_["Content-Length"] = ftos(body_.length());
-		fullResponse.append("\r\n\r\n");
-		fullResponse.append(body_);
-
-	}
-
-	int ret = send(fd, fullResponse.c_str() + total_sent_, fullResponse.length() - total_sent_, 0);
-	if (ret <= 0)
-	{
-		std::cerr << "send : " << strerror(errno) << std::endl;
-		return -1;
-	}
-
-	total_sent_ += ret;
-	if (total_sent_ >= fullResponse.length())
-		return 0;
-
-	return 1;
-}
-
 bool HttpResponse::isCgi(std::string ext)
 {
-	VecStr &cgi = config_.getCgi();
+	const VecStr &cgi = config_.getCgi();
 	return std::find(cgi.begin(), cgi.end(), ext) != cgi.end();
 }
 
+// Runs the script to its end inside the event loop: the worker serves no
+// other client meanwhile, cgi_timeout bounds how long that lasts
 void HttpResponse::HandleCgi()
 {
 	CgiHandle cgi(&config_, file_->getMimeExt());
@@ -411,12 +385,19 @@ void HttpResponse::HandleCgi()
 		return ;
 	}
 	setCgiPipe(cgi);
-	std::string req_body = config_.getBody();
+	uint64_t deadline = monotonicMsec() + config_.getCgiTimeout();
 	while (status_code_ == 0)
 	{
 		// std::cout << "STATUS: " << status_code_ << std::endl;
-		toCgi(cgi, req_body);
+		toCgi(cgi);
 		fromCgi(cgi);
+		if (status_code_ == 0 && monotonicMsec() >= deadline)
+		{
+			std::cerr << "CGI timed out, killing " << cgi.getPid() << std::endl;
+			kill(-cgi.getPid(), SIGKILL);
+			body_.clear();
+			status_code_ = 504;
+		}
 	}
 	waitpid(cgi.getPid(), &exit_status, 0);
 	closeParentCgiPipe(cgi);
@@ -425,18 +406,21 @@ void HttpResponse::HandleCgi()
 	std::cout << "STATUS: " << status_code_ << std::endl;
 }
 
-void HttpResponse::toCgi(CgiHandle &cgi, std::string &req_body)
+// Feeds the script the next piece of the request body, straight from
+// memory or the spilled temp file
+void HttpResponse::toCgi(CgiHandle &cgi)
 {
 	if (cgi.getContentLength() > 0)
 	{
-		std::string body = req_body;
-		int bytesWritten = write(cgi.getPipeIn(), req_body.c_str(), req_body.length());
+		const BodyBuffer &body = config_.getBody();
+		char buffer[BODY_STREAM_CHUNK];
+		ssize_t bytesRead = body.read(body.size() - cgi.getContentLength(), buffer, sizeof(buffer));
+		ssize_t bytesWritten = bytesRead > 0 ? write(cgi.getPipeIn(), buffer, bytesRead) : -1;
 		if (bytesWritten >= 0)
 		{
-			req_body = req_body.substr(bytesWritten);
 			cgi.deductContentLength(bytesWritten);
 			if (cgi.getContentLength() == 0)
-				close(cgi.getPipeIn());
+				cgi.closePipeIn();
 		}
 		if (bytesWritten == -1)
 		{
@@ -457,7 +441,8 @@ void HttpResponse::fromCgi(CgiHandle &cgi)
 	struct timeval tv;
 	tv.tv_sec = 1;
 	tv.tv_usec = 0;
-	if (select(cgi.getPipeOut() + 1, &readfds, NULL, NULL, &tv) > 0)
+	int ready = select(cgi.getPipeOut() + 1, &readfds, NULL, NULL, &tv);
+	if (ready > 0)
 	{
 		if ((bytesRead = read(cgi.getPipeOut(), buffer, sizeof(buffer))) > 0)
 		{
@@ -473,13 +458,12 @@ void HttpResponse::fromCgi(CgiHandle &cgi)
 			return ;
 		}
 	}
-	else if (select(cgi.getPipeOut() + 1, &readfds, NULL, NULL, &tv) == -1)
+	else if (ready == -1 && errno != EINTR)
 	{
 		std::cerr << "Error reading CGI response" << std::endl;
 		status_code_ = 500;
 	}
-	else
-		status_code_ = 200;
+	// nothing yet: keep waiting until EOF or the cgi_timeout deadline
 }
 
 void HttpResponse::setCgiPipe(CgiHandle &cgi)
@@ -520,7 +504,7 @@ void HttpResponse::parseCgiHeaders()
 			}
 		}
 	}
-	for (std::map<std::string, std::string>::iterator it = headers_.begin(); it != headers_.end(); it++)
+	for (ArenaMap<std::string, std::string>::type::iterator it = headers_.begin(); it != headers_.end(); it++)
 	{
 		std::cout << "Key: " << it->first << ", Value: " << it->second << std::endl;
 	}
@@ -556,8 +540,5 @@ void HttpResponse::handleCgiHeaders(std::string &body_)
 
 void HttpResponse::closeParentCgiPipe(CgiHandle &cgi)
 {
-	if (cgi.getPipeIn() != -1)
-		close(cgi.getPipeIn());
-	if (cgi.getPipeOut() != -1)
-		close(cgi.getPipeOut());
+	cgi.closePipe();
 }
\ No newline at end of file
@@ -0,0 +1,34 @@
+#include "../../inc/PathLock.hpp"
+
+pthread_rwlock_t PathLock::locks_[PATH_LOCK_STRIPES];
+pthread_once_t PathLock::once_ = PTHREAD_ONCE_INIT;
+
+// Writers go first, a stream of GETs must not hold a PUT back forever
+void PathLock::initLocks()
+{
+    pthread_rwlockattr_t attr;
+    pthread_rwlockattr_init(&attr);
+    pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+    for (size_t i = 0; i < PATH_LOCK_STRIPES; ++i)
+        pthread_rwlock_init(&locks_[i], &attr);
+    pthread_rwlockattr_destroy(&attr);
+}
+
+PathLock::PathLock(const std::string &path, Mode mode)
+{
+    size_t hash = 5381;
+    for (size_t i = 0; i < path.size(); ++i)
+        hash = hash * 33 + static_cast<unsigned char>(path[i]);
+
+    pthread_once(&once_, initLocks);
+    lock_ = &locks_[hash % PATH_LOCK_STRIPES];
+    if (mode == READ)
+        pthread_rwlock_rdlock(lock_);
+    else
+        pthread_rwlock_wrlock(lock_);
+}
+
+PathLock::~PathLock()
+{
+    pthread_rwlock_unlock(lock_);
+}
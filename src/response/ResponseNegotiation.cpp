@@ -97,7 +97,7 @@ int ftstoi(const std::string &str, std::size_t *pos = NULL, int base = 10) {
 }
 
 bool HttpResponse::localization(std::vector<std::string> &matches) {
-    std::string all = config_.getHeader("Accept-Language");
+    std::string all = config_.getHeader(HEADER_ACCEPT_LANGUAGE).str(); // consumed while parsing
     int maxQ = 0;
     std::vector<std::string> selectMatches;
     std::string defaultLanguage = "en";
@@ -219,7 +219,7 @@ std::string HttpResponse::handleDefaultCharset(const std::string &bestCharset)
 
 std::string HttpResponse::accept_charset(std::vector<std::string> &matches)
 {
-  std::string all = config_.getHeader("Accept-Charset");
+  std::string all = config_.getHeader(HEADER_ACCEPT_CHARSET).str();
   std::vector<CharsetAndQ> charsetAndQValues;
 
   size_t pos = 0;
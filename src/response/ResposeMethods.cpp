@@ -1,15 +1,11 @@
 #include "../../inc/HttpResponse.hpp"
-
-pthread_mutex_t g_write;
+#include "../../inc/PathLock.hpp"
 
 int HttpResponse::GET()
 {
-    pthread_mutex_lock(&g_write);
-
     if (!file_)
     {
         std::cerr << "File not found" << std::endl;
-        pthread_mutex_unlock(&g_write);
         return 500;
     }
 
@@ -28,45 +24,43 @@ int HttpResponse::GET()
         if (!charset_.empty())
             headers_["Content-Type"] += "; charset=" + charset_;
 
-        body_ = file_->getContent();
+        PathLock lock(file_->getFilePath(), PathLock::READ);
+        file_->getContent(body_);
     }
     headers_["Content-Length"] = ftos(body_.length());
     headers_["Cache-Control"] = "no-cache";
 
-    pthread_mutex_unlock(&g_write);
-
     return 200;
 }
 
 int HttpResponse::POST()
 {
     int status_code = 500;
+    const BodyBuffer &body = config_.getBody();
 
-    body_ = config_.getBody();
-
-    pthread_mutex_lock(&g_write);
+    PathLock lock(file_->getFilePath());
     if (!file_->exists())
     {
-        file_->createFile(body_);
+        file_->createFile(body);
         status_code = 201;
     }
     else
     {
         MimeTypes mimeTypes;
         std::map<std::string, std::string> mimeMap = mimeTypes.getMap();
+        HeaderValue contentType = config_.getHeader(HEADER_CONTENT_TYPE);
         for (std::map<std::string, std::string>::iterator it = mimeMap.begin(); it != mimeMap.end(); ++it)
         {
-            if (it->second == config_.getHeader("content-type"))
+            if (contentType == it->second)
             {
-                file_->appendFile(body_, it->first);
+                file_->appendFile(body, it->first);
                 status_code = 200;
                 break;
             }
         }
     }
-    pthread_mutex_unlock(&g_write);
 
-    headers_["Content-Length"] = ftos(body_.length());
+    headers_["Content-Length"] = "0";
 
     if (!file_->getFilePath().empty())
         headers_["Location"] = file_->getFilePath();
@@ -76,17 +70,16 @@ int HttpResponse::POST()
 
 int HttpResponse::PUT()
 {
-    pthread_mutex_lock(&g_write);
-
     int status_code = 204;
 
     if (!file_)
     {
         std::cerr << "File not found" << std::endl;
-        pthread_mutex_unlock(&g_write);
         return 500;
     }
 
+    PathLock lock(file_->getFilePath());
+
     if (file_->exists())
     {
         file_->createFile(config_.getBody());
@@ -97,20 +90,16 @@ int HttpResponse::PUT()
         if (!file_->exists())
         {
             std::cerr << "Failed to create file" << std::endl;
-            pthread_mutex_unlock(&g_write);
             return 500;
         }
         headers_["Content-Length"] = "0";
         status_code = 201;
     }
-    pthread_mutex_unlock(&g_write);
     return status_code;
 }
 
 int HttpResponse::DELETE()
 {
-    pthread_mutex_lock(&g_write);
-
     int status_code = 200;
 
     if (!file_)
@@ -120,6 +109,8 @@ int HttpResponse::DELETE()
     }
     else
     {
+        PathLock lock(file_->getFilePath());
+
         if (!file_->exists())
         {
             std::cerr << "File does not exist" << std::endl;
@@ -139,7 +130,6 @@ int HttpResponse::DELETE()
         }
     }
 
-    pthread_mutex_unlock(&g_write);
     std::string header = "<!DOCTYPE html>\n\
                  <html>\n\
                  <body>\n";
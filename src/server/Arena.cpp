@@ -0,0 +1,83 @@
+#include "../../inc/Arena.hpp"
+#include <cstdlib>
+
+// Block headers are padded so the data after them stays aligned
+static size_t headerSize()
+{
+    return (sizeof(void *) + sizeof(size_t) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+Arena::Arena() : first_(NULL), current_(NULL), ptr_(NULL), end_(NULL)
+{
+}
+
+Arena::~Arena()
+{
+    while (first_)
+    {
+        Block *next = first_->next;
+        std::free(first_);
+        first_ = next;
+    }
+}
+
+void *Arena::allocate(size_t size)
+{
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    if (size > static_cast<size_t>(end_ - ptr_))
+        return nextBlock(size);
+    void *p = ptr_;
+    ptr_ += size;
+    return p;
+}
+
+// Moves on to the block after current_, reusing one kept from an earlier
+// request when it is large enough
+void *Arena::nextBlock(size_t size)
+{
+    Block *block = current_ ? current_->next : first_;
+    if (!block || block->size < size)
+    {
+        size_t data = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+        Block *fresh = static_cast<Block *>(std::malloc(headerSize() + data));
+        if (!fresh)
+            throw std::bad_alloc();
+        fresh->size = data;
+        fresh->next = block;
+        if (current_)
+            current_->next = fresh;
+        else
+            first_ = fresh;
+        block = fresh;
+    }
+    current_ = block;
+    ptr_ = reinterpret_cast<char *>(block) + headerSize() + size;
+    end_ = reinterpret_cast<char *>(block) + headerSize() + block->size;
+    return reinterpret_cast<char *>(block) + headerSize();
+}
+
+/// @note everything allocated since the last reset must be destroyed already
+void Arena::reset()
+{
+    current_ = first_;
+    if (!first_)
+        return;
+    ptr_ = reinterpret_cast<char *>(first_) + headerSize();
+    end_ = ptr_ + first_->size;
+}
+
+size_t Arena::capacity() const
+{
+    size_t total = 0;
+    for (Block *block = first_; block; block = block->next)
+        total += block->size;
+    return total;
+}
+
+size_t Arena::blocks() const
+{
+    size_t count = 0;
+    for (Block *block = first_; block; block = block->next)
+        count++;
+    return count;
+}
@@ -17,7 +17,9 @@
 
 CgiHandle::CgiHandle(RequestConfig *config, std::string cgi_ext)
 : _config(config), _cgi_path(""), _cgi_pid(-1), _cgi_ext(cgi_ext), _exit_status(0),
-	_argv(NULL), _envp(NULL), _path(NULL), pipe_in(), pipe_out(), content_length(0){
+	_argv(NULL), _envp(NULL), _path(NULL), content_length(0){
+	this->pipe_in[0] = this->pipe_in[1] = -1;
+	this->pipe_out[0] = this->pipe_out[1] = -1;
 	this->initEnv();
 }
 
@@ -55,14 +57,13 @@ void CgiHandle::initEnv(){
 
 	std::stringstream ss;
 	
-	if (this->_config->getMethod() == "POST")
+	if (this->_config->getMethod() == METHOD_POST)
 	{
-		this->_env["CONTENT_TYPE"] = this->_config->getHeader("content-type");
-		ss << this->_config->getHeader("content-length");
-		std::string content_length = ss.str();
-		this->_env["CONTENT_LENGTH"] = content_length;
-		this->content_length = atoi(content_length.c_str());
-		ss.clear();
+		HeaderValue type = this->_config->getHeader(HEADER_CONTENT_TYPE);
+		this->_env["CONTENT_TYPE"].assign(type.data, type.size);
+		// the decoded body size, also right for chunked uploads
+		this->content_length = this->_config->getBody().size();
+		this->_env["CONTENT_LENGTH"] = ftos(this->content_length);
 	}
 	this->_env["GATEWAY_INTERFACE"] = "CGI/1.1";
 	// this->_env["REMOTE_ADDR"] = getIp();
@@ -77,7 +78,7 @@ void CgiHandle::initEnv(){
 	this->_env["SERVER_SOFTWARE"] = "AMANIX";
 	this->_env["PATH"] = std::string (getenv("PATH"));
 	this->_env["SERVER_PROTOCOL"] = this->_config->getProtocol();
-	this->_env["REQUEST_METHOD"] = this->_config->getMethod();
+	this->_env["REQUEST_METHOD"] = Methods::name(this->_config->getMethod());
 	this->_env["PWD"] = std::string (getenv("PWD"));
 	this->_env["SCRIPT_NAME"] = this->_config->getUri();
 	this->_env["REDIRECT_STATUS"] = "200";
@@ -102,7 +103,6 @@ void CgiHandle::execCgi(){
 	this->setPath();
 	this->setArgv();
 	this->createEnvArray();
-	this->setPipe();
 	if (!this->_path || !this->_argv)// || !this->_envp)
 	{
 		std::cerr << "Error: execve argument creation failed" << std::endl;
@@ -122,6 +122,8 @@ void CgiHandle::execCgi(){
 	}
 	else if (_cgi_pid == 0)
 	{
+		// own process group, so a timed out script is killed with its children
+		setpgid(0, 0);
 		if (dup2(this->pipe_in[0], STDIN_FILENO) == -1 || dup2(this->pipe_out[1], STDOUT_FILENO) == -1
 			|| (_exit_status = execve(this->_argv[0], this->_argv, this->_envp)) == -1)
 		{
@@ -131,11 +133,18 @@ void CgiHandle::execCgi(){
 		}
 		closePipe();
 	}
+	// from both sides: a kill before the child ran its setpgid must still reach the group
+	setpgid(this->_cgi_pid, this->_cgi_pid);
+	// the child owns these ends now; keeping them open would hide its EOF
+	closeFd(this->pipe_in[0]);
+	closeFd(this->pipe_out[1]);
 	// waitpid(this->_cgi_pid, &this->_exit_status, 0);
 }
 
 int CgiHandle::setPipe(){
-	if (pipe(this->pipe_in) == -1 || pipe(this->pipe_out) == -1)
+	// close-on-exec keeps other threads' CGI children from inheriting our pipe ends;
+	// dup2 clears the flag on the child's stdin/stdout
+	if (pipe2(this->pipe_in, O_CLOEXEC) == -1 || pipe2(this->pipe_out, O_CLOEXEC) == -1)
 	{
 		closePipe();
 		std::cerr << "Error: pipe failed" << std::endl;
@@ -144,15 +153,22 @@ int CgiHandle::setPipe(){
 	return (0);
 }
 
+// Closes an end once and forgets it, the number may be reused by another connection
+void CgiHandle::closeFd(int &fd){
+	if (fd != -1)
+		close(fd);
+	fd = -1;
+}
+
+void CgiHandle::closePipeIn(){
+	closeFd(this->pipe_in[1]);
+}
+
 void CgiHandle::closePipe(){
-	if (this->pipe_in[0] != -1)
-		close(this->pipe_in[0]);
-	if (this->pipe_in[1] != -1)
-		close(this->pipe_in[1]);
-	if (this->pipe_out[0] != -1)
-		close(this->pipe_out[0]);
-	if (this->pipe_out[1] != -1)
-		close(this->pipe_out[1]);
+	closeFd(this->pipe_in[0]);
+	closeFd(this->pipe_in[1]);
+	closeFd(this->pipe_out[0]);
+	closeFd(this->pipe_out[1]);
 }
 
 std::string CgiHandle::getIp(){
@@ -197,7 +213,7 @@ int CgiHandle::getPipeOut(){
 int CgiHandle::getExitStatus(){
 	return this->_exit_status;
 }
-int CgiHandle::getContentLength(){
+size_t CgiHandle::getContentLength(){
 	return this->content_length;
 }
 
@@ -205,7 +221,7 @@ int CgiHandle::getPid(){
 	return this->_cgi_pid;
 }
 
-void CgiHandle::deductContentLength(int length){
+void CgiHandle::deductContentLength(size_t length){
 	this->content_length -= length;
 }
 
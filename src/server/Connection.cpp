@@ -0,0 +1,224 @@
+#include "../../inc/AllHeaders.hpp"
+#include "../../inc/Connection.hpp"
+
+Connection::Connection(int fd, int server_fd) : fd_(fd), server_fd_(server_fd), state_(READING), output_sent_(0), keep_alive_(false), requests_(0), id_(0), events_(0), sending_(false), receiving_(false)
+{
+    timer_.data = this;
+    std::memset(&msg_, 0, sizeof(msg_));
+}
+
+Connection::~Connection()
+{
+    if (fd_ != -1 && close(fd_) == -1)
+        std::cerr << "Close failed with error: " << strerror(errno) << std::endl;
+}
+
+int Connection::getFd() const
+{
+    return fd_;
+}
+
+int Connection::getServerFd() const
+{
+    return server_fd_;
+}
+
+Connection::State Connection::getState() const
+{
+    return state_;
+}
+
+void Connection::setState(State state)
+{
+    state_ = state;
+}
+
+HttpRequest &Connection::getRequest()
+{
+    return request_;
+}
+
+Arena &Connection::getArena()
+{
+    return arena_;
+}
+
+std::string &Connection::getReadBuffer()
+{
+    return read_buffer_;
+}
+
+bool Connection::getKeepAlive() const
+{
+    return keep_alive_;
+}
+
+void Connection::setKeepAlive(bool keepAlive)
+{
+    keep_alive_ = keepAlive;
+}
+
+size_t Connection::getRequestCount() const
+{
+    return requests_;
+}
+
+Timer &Connection::getTimer()
+{
+    return timer_;
+}
+
+// Prepares a persistent connection for its next request, which may
+// already be sitting in the read buffer
+void Connection::nextRequest()
+{
+    requests_++;
+    request_.takeUnparsed(read_buffer_);
+    request_.reset();
+    arena_.reset();
+}
+
+uint32_t Connection::getId() const
+{
+    return id_;
+}
+
+void Connection::setId(uint32_t id)
+{
+    id_ = id;
+}
+
+uint32_t Connection::getEvents() const
+{
+    return events_;
+}
+
+void Connection::setEvents(uint32_t events)
+{
+    events_ = events;
+}
+
+bool Connection::isSending() const
+{
+    return sending_;
+}
+
+void Connection::setSending(bool sending)
+{
+    sending_ = sending;
+}
+
+bool Connection::isReceiving() const
+{
+    return receiving_;
+}
+
+void Connection::setReceiving(bool receiving)
+{
+    receiving_ = receiving;
+}
+
+// Gives up ownership of the fd, for a backend that closes it asynchronously
+int Connection::release()
+{
+    int fd = fd_;
+    fd_ = -1;
+    return fd;
+}
+
+// Reads whatever the socket has ready. Returns the recv result.
+ssize_t Connection::fill()
+{
+    char buffer[4096];
+
+    ssize_t bytes = recv(fd_, buffer, sizeof(buffer), 0);
+    if (bytes > 0)
+        read_buffer_.append(buffer, bytes);
+    return bytes;
+}
+
+void Connection::append(const char *data, size_t size)
+{
+    read_buffer_.append(data, size);
+}
+
+void Connection::queueResponse(const std::string &response)
+{
+    if (response.empty())
+        return;
+    output_.push_back(response);
+}
+
+// Queues response by swapping it in, it is left empty
+void Connection::takeResponse(std::string &response)
+{
+    if (response.empty())
+        return;
+    output_.push_back(std::string());
+    output_.back().swap(response);
+}
+
+bool Connection::hasPendingOutput() const
+{
+    return !output_.empty();
+}
+
+// Describes the queued responses as one gathered write. The message stays
+// valid until the next call, even if more responses get queued meanwhile.
+const struct msghdr *Connection::pendingOutput()
+{
+    size_t count = std::min(output_.size(), static_cast<size_t>(OUTPUT_IOV_MAX));
+
+    iov_.resize(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        iov_[i].iov_base = const_cast<char *>(output_[i].data());
+        iov_[i].iov_len = output_[i].size();
+    }
+    iov_[0].iov_base = static_cast<char *>(iov_[0].iov_base) + output_sent_;
+    iov_[0].iov_len -= output_sent_;
+    std::memset(&msg_, 0, sizeof(msg_));
+    msg_.msg_iov = &iov_[0];
+    msg_.msg_iovlen = count;
+    return &msg_;
+}
+
+// Drops bytes the socket accepted, response by response
+void Connection::consume(size_t bytes)
+{
+    while (bytes > 0 && !output_.empty())
+    {
+        size_t left = output_.front().size() - output_sent_;
+        if (bytes < left)
+        {
+            output_sent_ += bytes;
+            return;
+        }
+        bytes -= left;
+        output_.pop_front();
+        output_sent_ = 0;
+    }
+}
+
+// Writes pending output until it is all sent or the socket buffer is full.
+// Returns the bytes written, -1 only when the socket failed.
+ssize_t Connection::flush()
+{
+    ssize_t total = 0;
+
+    while (hasPendingOutput())
+    {
+        ssize_t bytes = sendmsg(fd_, pendingOutput(), MSG_NOSIGNAL);
+        if (bytes == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            return -1;
+        }
+        consume(bytes);
+        total += bytes;
+    }
+    return total;
+}
@@ -12,24 +12,95 @@
 
 #include "../../inc/Servers.hpp"
 #include "../../inc/HttpRequest.hpp"
+#include "../../inc/Connection.hpp"
+#include "../../inc/Workers.hpp"
+#include "../../inc/TimerWheel.hpp"
+#include "../../inc/Uring.hpp"
+
+// io_uring user_data: operation in the low byte, then the fd, then the
+// connection id, so completions of a closed connection are recognised
+enum UringOp
+{
+	URING_ACCEPT = 1,
+	URING_RECV,
+	URING_SEND,
+	URING_CLOSE,
+	URING_CANCEL
+};
+
+// The part of a connection id that fits in user_data
+static uint32_t uringId(uint32_t id){
+	return id & 0xffffff;
+}
+
+static uint64_t userData(int op, int fd, uint32_t id){
+	return (static_cast<uint64_t>(uringId(id)) << 40) | (static_cast<uint64_t>(static_cast<uint32_t>(fd)) << 8) | op;
+}
+
+// Sent as is when a client is too slow to deliver its request
+static std::string buildRequestTimeout(){
+	std::string body = "<html><head><title>408 Request Timeout</title></head>"
+		"<body><h1>408 Request Timeout</h1></body></html>";
+	return "HTTP/1.1 408 Request Timeout\r\nContent-Type: text/html\r\nContent-Length: "
+		+ ftos(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+}
+
+static const std::string REQUEST_TIMEOUT_RESPONSE = buildRequestTimeout();
+
+// Sent as is to clients over worker_connections or max_connections, with
+// the headers HttpResponse::setErrorPageHeaders gives a 503
+static std::string buildServiceUnavailable(){
+	std::string body = "<html><head><title>503 Service Unavailable</title></head>"
+		"<body><h1>503 Service Unavailable</h1></body></html>";
+	return "HTTP/1.1 503 Service Unavailable\r\nContent-Type: text/html\r\nContent-Length: "
+		+ ftos(body.size()) + "\r\nRetry-After: 30\r\nConnection: close\r\n\r\n" + body;
+}
+
+static const std::string SERVICE_UNAVAILABLE_RESPONSE = buildServiceUnavailable();
+
+static const std::string CONTINUE_RESPONSE = "HTTP/1.1 100 Continue\r\n\r\n";
 
 //Servers constuctor
-Servers::Servers(ConfigDB &configDB) : _server_fds(), configDB_(configDB){
+Servers::Servers(const ConfigDB &configDB) : _server_fds(), _epoll_fds(-1), _max_events(DEFAULT_EPOLL_EVENTS), _last_sweep(0), _shared_listeners(false),
+	_worker_connections(0), _accept_paused_until(0),
+	_accept_wakeups(0), _accepted(0), _accept_batch_max(0), _listen_overflows(0), _shed(0), _accept_pauses(0), _last_stats(0),
+	_timers(new TimerWheel(monotonicMsec())), _now(monotonicMsec()), _uring(NULL), _next_id(0), configDB_(configDB), snapshot_(configDB.acquireSnapshot()){
 	_keyValues = configDB_.getKeyValue();
+	_shared_listeners = Workers::countFromConfig(configDB_) * Workers::threadsFromConfig(configDB_) > 1;
+	setBackend();
+	setMaxEvents();
+	setWorkerConnections();
 	createServers();
+	if (_server_fds.empty()) {
+		std::cerr << "No server could be created" << std::endl;
+		return; // one of several worker threads must not exit the process
+	}
 	initEvents();
 }
 
+// The loop never ran: nothing could be listened on
+bool Servers::failed() const {
+	return _server_fds.empty();
+}
+
 //Servers destructor
 Servers::~Servers() {
+	for (std::map<int, Connection *>::iterator it = _connections.begin(); it != _connections.end(); ++it)
+		delete it->second;
+	for (std::map<uint32_t, Connection *>::iterator it = _closing.begin(); it != _closing.end(); ++it)
+		delete it->second;
 	for (std::vector<int>::iterator it = _server_fds.begin(); it != _server_fds.end(); ++it)
 		close(*it);
-	close(_epoll_fds);
+	if (!_uring)
+		close(_epoll_fds);
+	delete _uring;
+	delete _timers;
+	snapshot_->release();
 }
 
 // Create socket
 int Servers::createSocket(){
-	int server_fd = socket(AF_INET, SOCK_STREAM, 0);
+	int server_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
 	if (server_fd == -1) {
 		std::cerr << "Socket creation failed" << std::endl;
 		return (0);
@@ -64,6 +135,10 @@ int Servers::bindSocket(std::string s_port){
 	}
 	int opt = 1;
 	setsockopt(_server_fds.back(), SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(int));
+	// every worker binds its own listener, the kernel spreads connections
+	// between them; alone, a second server on the same port must fail to bind
+	if (_shared_listeners)
+		setsockopt(_server_fds.back(), SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(int));
 	struct sockaddr_in address;
 	std::memset(&address, 0, sizeof(address));
 	address.sin_family = AF_INET;
@@ -76,29 +151,34 @@ int Servers::bindSocket(std::string s_port){
 		std::cerr << "Bind failed" << std::endl;
 		return (0);
 	}
-	for (std::map<int, std::vector<std::string> >::iterator it = server_index.begin(); it != server_index.end(); it++){
-		for (std::vector<std::string>::iterator it2 = it->second.begin(); it2 != it->second.end(); it2++){
-			if (*it2 == s_port)
-				server_fd_to_index[_server_fds.back()] = it->first;
-		}
+	// the first server listening here is the default one, see serverFor
+	for (std::map<int, std::vector<std::string> >::reverse_iterator it = server_index.rbegin(); it != server_index.rend(); it++){
+		if (std::find(it->second.begin(), it->second.end(), s_port) == it->second.end())
+			continue;
+		server_fd_to_index[_server_fds.back()] = it->first;
+		setTimeouts(it->first);
+		setBodyBuffer(it->first);
 	}
 	return (1);
 }
 
 
 // Create epoll instance
-void	Servers::createEpoll(){
+int	Servers::createEpoll(){
+	if (_uring)
+		return (1);
 	int epoll_fd = epoll_create1(0);
 	this->_epoll_fds = epoll_fd;
 	if (epoll_fd < 0) {
 		std::cerr << "Epoll creation failed" << std::endl;
-		exit(1);
+		return (0);
 	}
+	return (1);
 }
 
-// Listen on socket
-int Servers::listenSocket(){
-	if (listen(_server_fds.back(), SOMAXCONN) == -1) {
+// Listen on socket, backlog comes from the listen directive's backlog= parameter
+int Servers::listenSocket(int backlog){
+	if (listen(_server_fds.back(), backlog) == -1) {
 		std::cerr << "Listen failed" << std::endl;
 		return (0);
 	}
@@ -107,17 +187,27 @@ int Servers::listenSocket(){
 
 // Combine file descriptors into epoll instance
 int Servers::combineFds(){
-	int flags = fcntl(_server_fds.back(), F_SETFL, O_NONBLOCK, FD_CLOEXEC);
-	if (flags == -1)
+	int flags = fcntl(_server_fds.back(), F_GETFL, 0);
+	if (flags == -1 || fcntl(_server_fds.back(), F_SETFL, flags | O_NONBLOCK) == -1)
 	{
 		std::cerr << "Fcntl failed" << std::endl;
 		return (0);
 	}
+	if (_uring)
+		return (1); // armed with a multishot accept once the loop starts
+	return watchListener(_server_fds.back());
+}
+
+// Adds a listener to the epoll set
+int Servers::watchListener(int server_fd){
 	struct epoll_event event;
 	std::memset(&event, 0, sizeof(event));
 	event.events = EPOLLIN;
-	event.data.fd = _server_fds.back();
-	if (epoll_ctl(this->_epoll_fds, EPOLL_CTL_ADD, _server_fds.back(), &event) == -1) {
+	// with several event loops only one of them is woken per new connection
+	if (_shared_listeners)
+		event.events |= EPOLLEXCLUSIVE;
+	event.data.fd = server_fd;
+	if (epoll_ctl(this->_epoll_fds, EPOLL_CTL_ADD, server_fd, &event) == -1) {
 		std::cerr << "Epoll_ctl failed" << std::endl;
 		return (0);
 	}
@@ -129,16 +219,21 @@ void Servers::createServers(){
 	
 	std::cout << "Creating servers" << std::endl;
 	std::vector<std::string> ports;
-	createEpoll();
+	if (!createEpoll())
+		return;
 	ports = getPorts();
 	for (std::vector<std::string>::iterator it2 = ports.begin(); it2 != ports.end(); it2++) {
 		if (!checkSocket(*it2)){
 			if (createSocket()){
-				if (!bindSocket(*it2) || !listenSocket() || !combineFds())
+				std::map<std::string, int>::iterator backlog = _listen_backlog.find(*it2);
+				if (!bindSocket(*it2) || !listenSocket(backlog != _listen_backlog.end() ? backlog->second : SOMAXCONN) || !combineFds())
 					_server_fds.pop_back();
 				else
 				{
-					assignDomain(*it2, _server_fds.back());
+					std::map<std::string, size_t>::iterator limit = _listen_max_connections.find(*it2);
+					if (limit != _listen_max_connections.end())
+						_max_connections[_server_fds.back()] = limit->second;
+					indexServerNames(*it2, _server_fds.back());
 					std::cout << "Server created on port " << _ip_to_server[_server_fds.back()] << ", server:" << _server_fds.back() << std::endl;
 				}
 			}
@@ -164,66 +259,646 @@ Listen getTargetIpAndPort(std::string requestedUrl) {
 	return Listen (x_ip, port_x);
 }
 
-// Handle incoming connection from clients
+// Accept every pending client of a listener and register them in the epoll set
 void Servers::handleIncomingConnection(int server_fd){
-	struct sockaddr_in address;
-	// struct timeval timeout;
-	std::string request;
-    socklen_t addrlen = sizeof(address);
-    char ip[INET_ADDRSTRLEN];
-    int new_socket = accept(server_fd, (struct sockaddr *)&address, &addrlen);
-	bool finish = false;
-    if (new_socket == -1) {
-        std::cerr << "Accept failed." << std::endl;
-        return;
-    }
-	if (inet_ntop(AF_INET, &(address.sin_addr), ip, INET_ADDRSTRLEN) == NULL) {
-    	std::cerr << "inet_ntop failed with error: " << strerror(errno) << std::endl;
-		close(new_socket);
-    	return;
-}
-    std::cout << "Connection established on IP: " << _ip_to_server[server_fd] << ", server:" << server_fd << "\n" << std::endl;
-	int flags = fcntl(new_socket, F_SETFL, FD_CLOEXEC, O_NONBLOCK);//COMMENT THE 0_NONBLOCK LINE IF THE BEHAVIOUR IS UNDEFINED.
-	if (flags == -1)
-	{
-		std::cerr << "Fcntl failed" << std::endl;
-		close(new_socket);
+	unsigned long batch = 0;
+	while (true) {
+		int new_socket = accept4(server_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (new_socket == -1) {
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			if (errno == EMFILE || errno == ENFILE)
+				pauseAccepting();
+			else if (errno != EAGAIN && errno != EWOULDBLOCK)
+				std::cerr << "Accept failed: " << strerror(errno) << std::endl;
+			break;
+		}
+		batch++;
+		addConnection(new_socket, server_fd);
+	}
+	_accept_wakeups++;
+	_accepted += batch;
+	if (batch > _accept_batch_max)
+		_accept_batch_max = batch;
+}
+
+// Tracks an accepted client and starts reading from it, or sheds it when
+// a connection limit is reached
+void Servers::addConnection(int fd, int server_fd){
+	bool shed = overloaded(server_fd);
+	Connection *conn = new Connection(fd, server_fd);
+	conn->setId(++_next_id);
+	const ServerBodyBuffer &body = _body_buffers[server_fd_to_index[server_fd]];
+	conn->getRequest().setBodyBuffer(body.size, body.temp_path);
+	if (_uring)
+		armRecv(*conn);
+	else if (!watchConnection(*conn, EPOLLIN, EPOLL_CTL_ADD)) {
+		delete conn;
 		return;
 	}
-	HttpRequest parser;
+	_connections[fd] = conn;
+	_listener_connections[server_fd]++;
+	setDeadline(*conn, Connection::HEADER_DEADLINE);
+	if (shed)
+		rejectConnection(*conn);
+}
+
+// worker_connections counts every client of this event loop, max_connections
+// those of one listener
+bool Servers::overloaded(int server_fd){
+	if (_worker_connections && _connections.size() >= _worker_connections)
+		return true;
+	std::map<int, size_t>::iterator limit = _max_connections.find(server_fd);
+	return limit != _max_connections.end() && _listener_connections[server_fd] >= limit->second;
+}
+
+// Answers a client over the limits with the prebuilt 503, without parsing
+// anything, so the requests in flight keep their resources. Its request is
+// never read, so the close lingers like for a refused upload: closing
+// right away would have the kernel reset the connection and lose the 503.
+// The client holds its slot until it closes or LINGERING_TIMEOUT.
+void Servers::rejectConnection(Connection &conn){
+	_shed++;
+	conn.queueResponse(SERVICE_UNAVAILABLE_RESPONSE);
+	conn.setKeepAlive(false);
+	conn.setState(Connection::WRITING);
+	setDeadline(conn, Connection::SEND_DEADLINE);
+	startWrite(conn);
+}
+
+// Out of file descriptors: stop accepting for ACCEPT_PAUSE_MS instead of
+// spinning on a listener that stays readable. Connections waiting in the
+// backlog are picked up once some clients closed.
+void Servers::pauseAccepting(){
+	if (!_accept_paused_until)
+		_accept_pauses++;
+	_accept_paused_until = _now + ACCEPT_PAUSE_MS;
+	if (_uring)
+		return; // the failed multishot accepts are simply not re-armed
+	for (std::vector<int>::iterator it = _server_fds.begin(); it != _server_fds.end(); ++it) {
+		if (std::find(_paused_listeners.begin(), _paused_listeners.end(), *it) != _paused_listeners.end())
+			continue;
+		epoll_ctl(this->_epoll_fds, EPOLL_CTL_DEL, *it, NULL);
+		_paused_listeners.push_back(*it);
+	}
+}
+
+void Servers::resumeAccepting(){
+	_accept_paused_until = 0;
+	for (std::vector<int>::iterator it = _paused_listeners.begin(); it != _paused_listeners.end(); ++it) {
+		if (_uring)
+			_uring->accept(*it, userData(URING_ACCEPT, *it, 0));
+		else
+			watchListener(*it);
+	}
+	_paused_listeners.clear();
+}
 
-	int reqStatus = -1;
-	while (!finish){	
-		finish = getRequest(new_socket, request);
-		reqStatus = parser.parseRequest(request);
-		if (reqStatus != 200) {
-			finish = true;
+// Add or modify the events epoll reports for a client
+bool Servers::watchConnection(Connection &conn, uint32_t events, int op){
+	if (op == EPOLL_CTL_MOD && conn.getEvents() == events)
+		return true;
+	struct epoll_event event;
+	std::memset(&event, 0, sizeof(event));
+	event.events = events;
+	event.data.fd = conn.getFd();
+	if (epoll_ctl(this->_epoll_fds, op, conn.getFd(), &event) == -1) {
+		std::cerr << "Epoll_ctl failed: " << strerror(errno) << std::endl;
+		return false;
+	}
+	conn.setEvents(events);
+	return true;
+}
+
+// Remove a client from the epoll set and release it
+void Servers::closeConnection(Connection &conn){
+	int fd = conn.getFd();
+	_timers->remove(conn.getTimer());
+	if (_uring) {
+		if (conn.getState() != Connection::CLOSING) {
+			_uring->cancelAndClose(fd, userData(URING_CLOSE, fd, conn.getId()));
+			conn.setState(Connection::CLOSING);
+			conn.release();
+			_listener_connections[conn.getServerFd()]--;
+			_connections.erase(fd);
+			_closing[uringId(conn.getId())] = &conn;
 		}
-		if (!handleResponse(reqStatus, server_fd, new_socket, parser))
+		// a send the cancel came too late for still reads output_: keep the
+		// connection until its last completion, whatever reuses the fd meanwhile
+		if (conn.isSending() || conn.isReceiving())
 			return;
+		_closing.erase(uringId(conn.getId()));
+		delete &conn;
+		return;
+	}
+	epoll_ctl(this->_epoll_fds, EPOLL_CTL_DEL, fd, NULL);
+	_listener_connections[conn.getServerFd()]--;
+	_connections.erase(fd);
+	delete &conn;
+}
+
+// Read what the client sent and feed it to its parser
+void Servers::handleRead(Connection &conn){
+	if (getRequest(conn)) {
+		closeConnection(conn);
+		return;
+	}
+	processRequest(conn);
+}
+
+// Parses buffered input. Every complete request gets its response queued,
+// pipelined ones included, and the whole batch is written at once.
+void Servers::processRequest(Connection &conn){
+	bool answered = false;
+	while (true) {
+		int reqStatus = conn.getRequest().parseRequest(conn.getReadBuffer());
+		if (reqStatus == REQUEST_HEADERS_DONE && (reqStatus = checkHeaders(conn)) == REQUEST_INCOMPLETE)
+			reqStatus = conn.getRequest().parseRequest(conn.getReadBuffer());
+		if (reqStatus == REQUEST_INCOMPLETE)
+			break;
+		handleResponse(reqStatus, conn);
+		answered = true;
+		// requests after one that closes the connection are never answered
+		if (!conn.getKeepAlive())
+			break;
+		conn.nextRequest();
+		if (conn.getReadBuffer().empty())
+			break;
+	}
+	if (!answered) {
+		setReadDeadline(conn);
+		return;
+	}
+	conn.setState(Connection::WRITING);
+	setDeadline(conn, Connection::SEND_DEADLINE);
+	startWrite(conn);
+}
+
+// Runs when the headers of a request with a body are in, before any of the
+// body is read: a request its location refuses anyway is answered right
+// away, an accepted one gets the 100 Continue it may be waiting for
+int Servers::checkHeaders(Connection &conn){
+	int server_fd = conn.getServerFd();
+	Listen host_port = getTargetIpAndPort(_ip_to_server[server_fd]);
+	Client client(*snapshot_, host_port, conn.getRequest(), serverFor(conn), REQUEST_INCOMPLETE, conn.getArena());
+
+	int status = client.checkHeaders();
+	if (status == REQUEST_INCOMPLETE && conn.getRequest().expectsContinue())
+		sendInterim(conn, CONTINUE_RESPONSE);
+	return status;
+}
+
+// Sends a 1xx ahead of the final response while the request is still being
+// read. Whatever the socket does not take now goes out with the final one.
+void Servers::sendInterim(Connection &conn, const std::string &response){
+	conn.queueResponse(response);
+	if (_uring) {
+		if (!conn.isSending()) {
+			conn.setSending(true);
+			_uring->sendmsg(conn.getFd(), conn.pendingOutput(), userData(URING_SEND, conn.getFd(), conn.getId()));
+		}
+		return;
+	}
+	conn.flush(); // a failure shows again when the final response is written
+}
+
+// Deadline while waiting for input: idle between requests, or the header
+// deadline covering the whole header, or the body one for each read
+void Servers::setReadDeadline(Connection &conn){
+	HttpRequest &request = conn.getRequest();
+	if (request.inBody())
+		setDeadline(conn, Connection::BODY_DEADLINE);
+	else if (!request.hasStarted() && conn.getRequestCount() > 0)
+		setDeadline(conn, Connection::KEEPALIVE_DEADLINE);
+	else if (conn.getTimer().type != Connection::HEADER_DEADLINE || !conn.getTimer().active())
+		setDeadline(conn, Connection::HEADER_DEADLINE);
+}
+
+// Send pending output until the socket is full, then wait for the next
+// request or close the client
+void Servers::handleWrite(Connection &conn){
+	if (conn.flush() == -1) {
+		std::cerr << "Write failed with error: " << strerror(errno) << std::endl;
+		closeConnection(conn);
+		return;
+	}
+	writeProgress(conn);
+}
+
+// Next step once the socket accepted some output
+void Servers::writeProgress(Connection &conn){
+	if (conn.hasPendingOutput()) {
+		// backpressure: resume once the client drained its socket buffer
+		setDeadline(conn, Connection::SEND_DEADLINE);
+		if (_uring)
+			startWrite(conn);
+		else if (!watchConnection(conn, EPOLLOUT, EPOLL_CTL_MOD))
+			closeConnection(conn);
+		return;
+	}
+	if (!conn.getKeepAlive()) {
+		if (conn.getRequest().isComplete())
+			closeConnection(conn);
+		else
+			lingeringClose(conn);
+		return;
+	}
+	conn.setState(Connection::READING);
+	setReadDeadline(conn);
+	startRead(conn);
+}
+
+// epoll waits for EPOLLIN again; the io_uring recv is rearmed if a client
+// pipelining past URING_READ_AHEAD stopped it. Either way, pipelined bytes
+// read along with the last batch are parsed right away.
+void Servers::startRead(Connection &conn){
+	if (_uring)
+		armRecv(conn);
+	else if (!watchConnection(conn, EPOLLIN, EPOLL_CTL_MOD)) {
+		closeConnection(conn);
+		return;
+	}
+	if (!conn.getReadBuffer().empty())
+		processRequest(conn);
+}
+
+// Starts the multishot recv unless it is still armed
+void Servers::armRecv(Connection &conn){
+	if (conn.isReceiving())
+		return;
+	conn.setReceiving(true);
+	_uring->recv(conn.getFd(), userData(URING_RECV, conn.getFd(), conn.getId()));
+}
+
+// After a response to a request that was not read to its end, typically
+// a refused upload: closing at once would make the kernel answer the
+// client's next bytes with a reset that can destroy the response before it
+// was read. Stop writing and drop input until the client closes too.
+void Servers::lingeringClose(Connection &conn){
+	if (shutdown(conn.getFd(), SHUT_WR) == -1) {
+		closeConnection(conn);
+		return;
+	}
+	conn.setState(Connection::LINGERING);
+	conn.getReadBuffer().clear();
+	setDeadline(conn, Connection::LINGER_DEADLINE);
+	if (_uring)
+		armRecv(conn);
+	else if (!watchConnection(conn, EPOLLIN, EPOLL_CTL_MOD))
+		closeConnection(conn);
+}
+
+void Servers::drainLingering(Connection &conn){
+	ssize_t bytes = conn.fill();
+	conn.getReadBuffer().clear();
+	if (bytes == 0 || (bytes == -1 && errno != EAGAIN && errno != EWOULDBLOCK))
+		closeConnection(conn);
+}
+
+void Servers::startWrite(Connection &conn){
+	if (_uring) {
+		// an interim response may still be in flight; its completion sends the rest
+		if (conn.isSending())
+			return;
+		conn.setSending(true);
+		_uring->sendmsg(conn.getFd(), conn.pendingOutput(), userData(URING_SEND, conn.getFd(), conn.getId()));
+		return;
+	}
+	// most responses fit the socket buffer: write right away and only
+	// wait for EPOLLOUT when the client does not keep up
+	handleWrite(conn);
+}
+
+// (Re)arms the connection's single timer with a deadline of its server
+void Servers::setDeadline(Connection &conn, int type){
+	const ServerTimeouts &timeouts = _timeouts[server_fd_to_index[conn.getServerFd()]];
+	uint64_t delay = timeouts.header;
+	if (type == Connection::BODY_DEADLINE)
+		delay = timeouts.body;
+	else if (type == Connection::SEND_DEADLINE)
+		delay = timeouts.send;
+	else if (type == Connection::KEEPALIVE_DEADLINE)
+		delay = timeouts.keepalive;
+	else if (type == Connection::LINGER_DEADLINE)
+		delay = LINGERING_TIMEOUT;
+	conn.getTimer().type = type;
+	_timers->add(conn.getTimer(), _now + delay);
+}
+
+// A client too slow to send its request gets a 408, any other one is dropped
+void Servers::handleTimeout(Connection &conn){
+	int type = conn.getTimer().type;
+	if (type != Connection::HEADER_DEADLINE && type != Connection::BODY_DEADLINE) {
+		closeConnection(conn);
+		return;
+	}
+	conn.getRequest().timeout();
+	conn.setKeepAlive(false);
+	conn.queueResponse(REQUEST_TIMEOUT_RESPONSE);
+	conn.setState(Connection::WRITING);
+	setDeadline(conn, Connection::SEND_DEADLINE);
+	startWrite(conn);
+}
+
+void Servers::expireTimers(){
+	std::vector<Timer *> expired;
+	_timers->expire(_now, expired);
+	for (size_t i = 0; i < expired.size(); i++)
+		handleTimeout(*static_cast<Connection *>(expired[i]->data));
+}
+
+// TcpExt ListenOverflows: connections dropped because an accept queue was
+// full, counted for every listener of the host (network namespace), ours
+// or not. Linux keeps no such count per socket.
+static unsigned long readListenOverflows(){
+	std::ifstream netstat("/proc/net/netstat");
+	std::string names;
+	std::string values;
+	while (std::getline(netstat, names) && std::getline(netstat, values)) {
+		if (names.compare(0, 7, "TcpExt:") != 0)
+			continue;
+		std::istringstream name_stream(names);
+		std::istringstream value_stream(values);
+		std::string name;
+		std::string value;
+		while (name_stream >> name && value_stream >> value) {
+			if (name == "ListenOverflows")
+				return std::strtoul(value.c_str(), NULL, 10);
+		}
+	}
+	return 0;
+}
+
+void Servers::logAcceptStats(time_t now){
+	if (_last_stats == 0) {
+		_listen_overflows = readListenOverflows();
+		_last_stats = now;
+	}
+	if (now - _last_stats < ACCEPT_STATS_INTERVAL)
+		return;
+	unsigned long overflows = readListenOverflows();
+	if (_accept_wakeups > 0 || overflows != _listen_overflows || _shed > 0 || _accept_pauses > 0) {
+		std::cout << "accept: " << _accepted << " connections in " << _accept_wakeups << " wakeups ("
+			<< std::fixed << std::setprecision(2) << static_cast<double>(_accepted) / (_accept_wakeups ? _accept_wakeups : 1)
+			<< " per wakeup, max " << _accept_batch_max << "), host-wide listen queue overflows: "
+			<< overflows - _listen_overflows << ", shed with 503: " << _shed
+			<< ", paused out of fds: " << _accept_pauses << std::endl;
 	}
-    if (close(new_socket) == -1)
-		std::cerr << "Close failed with error: " << strerror(errno) << std::endl;
+	_accept_wakeups = 0;
+	_accepted = 0;
+	_accept_batch_max = 0;
+	_shed = 0;
+	_accept_pauses = 0;
+	_listen_overflows = overflows;
+	_last_stats = now;
 }
 
-// Initialize events that will be handled by epoll
+static uint64_t timeoutOr(const std::string &value, uint64_t fallback_sec){
+	return value.empty() ? fallback_sec * 1000 : parseMsec(value);
+}
+
+// keepalive_* and client timeouts of a server, its http block or defaults
+void Servers::setTimeouts(int server_idx){
+	ServerTimeouts &timeouts = _timeouts[server_idx];
+	timeouts.keepalive = timeoutOr(configDB_.getServerDirective(server_idx, "keepalive_timeout"), DEFAULT_KEEPALIVE_TIMEOUT);
+	timeouts.header = timeoutOr(configDB_.getServerDirective(server_idx, "client_header_timeout"), DEFAULT_CLIENT_TIMEOUT);
+	timeouts.body = timeoutOr(configDB_.getServerDirective(server_idx, "client_body_timeout"), DEFAULT_CLIENT_TIMEOUT);
+	timeouts.send = timeoutOr(configDB_.getServerDirective(server_idx, "send_timeout"), DEFAULT_CLIENT_TIMEOUT);
+
+	std::string requests = configDB_.getServerDirective(server_idx, "keepalive_requests");
+	_keepalive_requests[server_idx] = requests.empty() ? DEFAULT_KEEPALIVE_REQUESTS : std::atoi(requests.c_str());
+}
+
+// client_body_buffer_size and client_body_temp_path of a server, its http block or defaults
+void Servers::setBodyBuffer(int server_idx){
+	ServerBodyBuffer &body = _body_buffers[server_idx];
+	std::string size = configDB_.getServerDirective(server_idx, "client_body_buffer_size");
+	std::string path = configDB_.getServerDirective(server_idx, "client_body_temp_path");
+	// checked when the config was compiled
+	if (size.empty() || !parseSize(size, body.size))
+		body.size = DEFAULT_CLIENT_BODY_BUFFER_SIZE;
+	body.temp_path = path.empty() ? DEFAULT_CLIENT_BODY_TEMP_PATH : path;
+}
+
+void Servers::handleConnectionEvent(int fd, uint32_t events){
+	std::map<int, Connection *>::iterator it = _connections.find(fd);
+	if (it == _connections.end())
+		return;
+	Connection &conn = *it->second;
+	if ((events & (EPOLLERR | EPOLLHUP)) && !(events & EPOLLIN)) {
+		closeConnection(conn);
+		return;
+	}
+	if (conn.getState() == Connection::READING && (events & EPOLLIN))
+		handleRead(conn);
+	else if (conn.getState() == Connection::WRITING && (events & EPOLLOUT))
+		handleWrite(conn);
+	else if (conn.getState() == Connection::LINGERING && (events & EPOLLIN))
+		drainLingering(conn);
+}
+
+bool Servers::isServerFd(int fd){
+	return _ip_to_server.find(fd) != _ip_to_server.end();
+}
+
+// Number of ready fds a single epoll_wait may return: events { epoll_events N; }
+void Servers::setMaxEvents(){
+	std::string value = configDB_.getRootDirective("epoll_events", "events");
+	_max_events = std::atoi(value.c_str());
+	if (_max_events <= 0)
+		_max_events = DEFAULT_EPOLL_EVENTS;
+}
+
+// Connections one event loop serves at most: events { worker_connections N; }
+void Servers::setWorkerConnections(){
+	std::string value = configDB_.getRootDirective("worker_connections", "events");
+	int connections = std::atoi(value.c_str());
+	_worker_connections = connections > 0 ? connections : 0;
+}
+
+// events { use epoll | io_uring; }, io_uring falls back to epoll when unavailable
+void Servers::setBackend(){
+	std::string backend = configDB_.getRootDirective("use", "events");
+	if (backend != "io_uring")
+		return;
+	_uring = new Uring();
+	if (!_uring->setup()) {
+		std::cerr << "io_uring unavailable, using epoll" << std::endl;
+		delete _uring;
+		_uring = NULL;
+	}
+}
+
+// Runs the event loop of the selected backend
 void Servers::initEvents(){
+	if (_uring)
+		runUring();
+	else
+		runEpoll();
+}
+
+// How long the loop may sleep: until the next timer or the end of an accept pause
+int Servers::waitTimeout(){
+	int timeout = _connections.empty() ? -1 : _timers->nextTimeout(_now, 1000);
+	if (_accept_paused_until) {
+		int left = _accept_paused_until > _now ? static_cast<int>(_accept_paused_until - _now) : 0;
+		if (timeout == -1 || left < timeout)
+			timeout = left;
+	}
+	return timeout;
+}
+
+// Expires timers, ends accept pauses and logs statistics once per loop iteration
+void Servers::afterEvents(){
+	expireTimers();
+	if (_accept_paused_until && _now >= _accept_paused_until)
+		resumeAccepting();
+	time_t now = time(NULL);
+	if (now != _last_sweep) {
+		logAcceptStats(now);
+		_last_sweep = now;
+	}
+}
+
+void Servers::runEpoll(){
+	std::vector<struct epoll_event> events(_max_events);
 	while (true){
 		try{
-			struct epoll_event events[_server_fds.size()];
-			int n = epoll_wait(this->_epoll_fds, events, _server_fds.size(), -1);
+			int n = epoll_wait(this->_epoll_fds, &events[0], _max_events, waitTimeout());
+			_now = monotonicMsec();
 			if (n == -1) {
+				if (errno == EINTR)
+					continue;
 				std::cerr << "Epoll_wait failed" << std::endl;
 				return ;
 			}
 			for (int i = 0; i < n; i++) {
-				for (std::vector<int>::iterator it2 = _server_fds.begin(); it2 != _server_fds.end(); ++it2) {
-					if (events[i].data.fd == *it2) {
-						std::cout << "\nIncoming connection on server: " << *it2 << std::endl;
-						handleIncomingConnection(*it2);
-					}
-				}
+				if (isServerFd(events[i].data.fd))
+					handleIncomingConnection(events[i].data.fd);
+				else
+					handleConnectionEvent(events[i].data.fd, events[i].events);
 			}
+			afterEvents();
+		} catch (std::exception &e){
+			std::cerr << e.what() << std::endl;
+		}
+	}
+}
+
+// The connection a completion belongs to, closing ones included, NULL once
+// it was deleted
+Connection *Servers::findConnection(uint64_t user_data){
+	int fd = static_cast<int>((user_data >> 8) & 0xffffffff);
+	uint32_t id = static_cast<uint32_t>(user_data >> 40);
+	std::map<int, Connection *>::iterator it = _connections.find(fd);
+	if (it != _connections.end() && uringId(it->second->getId()) == id)
+		return it->second;
+	std::map<uint32_t, Connection *>::iterator closing = _closing.find(id);
+	return closing == _closing.end() ? NULL : closing->second;
+}
+
+void Servers::handleCompletion(const UringCompletion &completion){
+	int op = completion.user_data & 0xff;
+	int fd = static_cast<int>((completion.user_data >> 8) & 0xffffffff);
+	bool more = _uring->hasMore(completion);
+
+	if (op == URING_ACCEPT) {
+		if (completion.res >= 0) {
+			_accepted++;
+			addConnection(completion.res, fd);
+		}
+		else if (completion.res == -EMFILE || completion.res == -ENFILE)
+			pauseAccepting();
+		else if (completion.res != -EAGAIN && completion.res != -ECONNABORTED)
+			std::cerr << "Accept failed: " << strerror(-completion.res) << std::endl;
+		if (!more && _accept_paused_until)
+			_paused_listeners.push_back(fd);
+		else if (!more)
+			_uring->accept(fd, completion.user_data);
+		return;
+	}
+
+	Connection *conn = findConnection(completion.user_data);
+	if (op == URING_CANCEL)
+		return; // the recv it was meant for had already ended
+	if (op == URING_RECV) {
+		if (conn && completion.res > 0 && conn->getState() != Connection::CLOSING)
+			conn->append(_uring->buffer(completion), completion.res);
+		if (_uring->hasBuffer(completion))
+			_uring->recycle(completion);
+		if (!conn)
+			return;
+		if (!more)
+			conn->setReceiving(false);
+		if (conn->getState() == Connection::CLOSING) {
+			if (!more)
+				closeConnection(*conn);
+			return;
+		}
+		if (completion.res == 0 || (completion.res < 0 && completion.res != -ENOBUFS && completion.res != -ECANCELED)) {
+			closeConnection(*conn);
+			return;
+		}
+		if (conn->getState() == Connection::READING && completion.res > 0)
+			processRequest(*conn);
+		else if (conn->getState() == Connection::LINGERING)
+			conn->getReadBuffer().clear();
+		// like epoll, stop reading a client that pipelines faster than it
+		// takes its responses; startRead rearms once the output is out
+		else if (more && completion.res > 0 && conn->getReadBuffer().size() >= URING_READ_AHEAD
+			&& conn->getReadBuffer().size() - completion.res < URING_READ_AHEAD)
+			_uring->cancel(completion.user_data, userData(URING_CANCEL, fd, conn->getId()));
+		// processRequest may have closed it
+		conn = findConnection(completion.user_data);
+		if (!more && conn && conn->getState() != Connection::CLOSING && conn->getState() != Connection::WRITING)
+			armRecv(*conn);
+	}
+	else if (op == URING_SEND && conn) {
+		conn->setSending(false);
+		if (conn->getState() == Connection::CLOSING) {
+			closeConnection(*conn);
+			return;
+		}
+		if (completion.res == -EAGAIN || completion.res == -EINTR) {
+			startWrite(*conn);
+			return;
+		}
+		if (completion.res < 0) {
+			closeConnection(*conn);
+			return;
+		}
+		conn->consume(completion.res);
+		// an interim response went out while the request is still read
+		if (conn->getState() == Connection::READING) {
+			if (conn->hasPendingOutput())
+				startWrite(*conn);
+			return;
+		}
+		writeProgress(*conn);
+	}
+}
+
+void Servers::runUring(){
+	std::vector<UringCompletion> completions;
+	for (std::vector<int>::iterator it = _server_fds.begin(); it != _server_fds.end(); ++it)
+		_uring->accept(*it, userData(URING_ACCEPT, *it, 0));
+	while (true){
+		try{
+			if (_uring->wait(waitTimeout()) == -1) {
+				std::cerr << "io_uring_enter failed: " << strerror(errno) << std::endl;
+				return ;
+			}
+			_now = monotonicMsec();
+			_uring->reap(completions);
+			unsigned long accepted = _accepted;
+			for (size_t i = 0; i < completions.size(); i++)
+				handleCompletion(completions[i]);
+			if (_accepted != accepted) {
+				_accept_wakeups++;
+				if (_accepted - accepted > _accept_batch_max)
+					_accept_batch_max = _accepted - accepted;
+			}
+			afterEvents();
 		} catch (std::exception &e){
 			std::cerr << e.what() << std::endl;
 		}
@@ -257,20 +932,30 @@ std::vector<std::string> Servers::getPorts(){
 		std::map<std::string, std::vector<std::string> >::iterator it_server = config.find(server);
 		if (it_server != config.end()){
 			ports_temp = it_server->second;
+			int backlog = 0;
+			int max_connections = 0;
 			for (std::vector<std::string>::iterator it2 = ports_temp.begin(); it2 != ports_temp.end(); it2++){
+				if (it2->compare(0, 8, "backlog=") == 0)
+					backlog = std::atoi(it2->c_str() + 8);
+				else if (it2->compare(0, 16, "max_connections=") == 0)
+					max_connections = std::atoi(it2->c_str() + 16);
+			}
+			for (std::vector<std::string>::iterator it2 = ports_temp.begin(); it2 != ports_temp.end(); it2++){
+				if (it2->find('=') != std::string::npos)
+					continue;
+				if (backlog > 0)
+					_listen_backlog[*it2] = backlog;
+				if (max_connections > 0)
+					_listen_max_connections[*it2] = max_connections;
 				if (std::find(ports.begin(), ports.end(), *it2) == ports.end())
-				{
 					ports.push_back(*it2);
-					server_index[i].push_back(*it2);
-				}
+				server_index[i].push_back(*it2);
 			}
 		}
 		else if (it_server_name != config.end() && it_server == config.end()){
 			if (std::find(ports.begin(), ports.end(), "80") == ports.end())
-			{
 				ports.push_back("80");
-				server_index[i].push_back("80");
-			}
+			server_index[i].push_back("80");
 		}
 		else
 			return (ports);
@@ -278,54 +963,31 @@ std::vector<std::string> Servers::getPorts(){
 	return (ports);
 }
 
-// Getting local domains and saving them to a map for each server
-void Servers::assignLocalDomain(int server_fd){
-	std::map<std::string, std::vector<std::string> > config = getKeyValue();
-	for (std::map<std::string, std::vector<std::string> >::iterator it_domain = config.begin(); it_domain != config.end(); it_domain++){
-		if (it_domain->first.find("server_name") != std::string::npos){
-			std::string server_name = it_domain->first;
-			std::size_t pos = server_name.find("]");
-			server_name = server_name.substr(0, pos + 1);
-			std::string domain = server_name + ".listen";
-			std::map<std::string, std::vector<std::string> >::iterator it_domain_listen = config.find(domain);
-				if (it_domain_listen == config.end()){
-					for (std::vector<std::string>::iterator it = it_domain->second.begin(); it != it_domain->second.end(); it++){
-					if (std::find(_domain_to_server[server_fd].begin(), _domain_to_server[server_fd].end(), *it) == _domain_to_server[server_fd].end())
-						_domain_to_server[server_fd].push_back(*it);
-				}
-			}
+// Indexes the server_name of every server listening on port, for serverFor
+void Servers::indexServerNames(const std::string &port, int server_fd){
+	VirtualHosts &hosts = _virtual_hosts[server_fd];
+	for (std::map<int, std::vector<std::string> >::iterator it = server_index.begin(); it != server_index.end(); it++){
+		if (std::find(it->second.begin(), it->second.end(), port) == it->second.end())
+			continue;
+		const std::vector<std::string> &names = snapshot_->server(it->first).names;
+		for (std::vector<std::string>::const_iterator name = names.begin(); name != names.end(); name++){
+			if (!hosts.add(*name, it->first))
+				std::cerr << "Conflicting server name \"" << *name << "\" on " << port << ", ignored" << std::endl;
 		}
 	}
 }
 
-// Getting domains and saving them to a map for each server
-void Servers::assignDomain(std::string port, int server_fd){
-	if (port == "80")
-		assignLocalDomain(server_fd);
-	std::map<std::string, std::vector<std::string> > config = getKeyValue();
-	for (std::map<std::string, std::vector<std::string> >::iterator it = config.begin(); it != config.end(); it++)
-	{
-		for (std::vector<std::string>::iterator it2 = it->second.begin(); it2 != it->second.end(); it2++)
-		{
-			if (*it2 == port){
-				std::string server_name = it->first;
-				std::size_t pos = server_name.find("]");
-				server_name = server_name.substr(0, pos + 1);
-				std::string domain = server_name + ".server_name";
-				std::map<std::string, std::vector<std::string> >::iterator it_domain = config.find(domain);
-				if (it_domain != config.end()){
-					for (std::vector<std::string>::iterator it3 = it_domain->second.begin(); it3 != it_domain->second.end(); it3++){
-						if (std::find(_domain_to_server[server_fd].begin(), _domain_to_server[server_fd].end(), *it3) == _domain_to_server[server_fd].end())
-							_domain_to_server[server_fd].push_back(*it3);
-					}
-				}
-				else{
-					if (std::find(_domain_to_server[server_fd].begin(), _domain_to_server[server_fd].end(), "localhost") == _domain_to_server[server_fd].end())
-						_domain_to_server[server_fd].push_back("localhost");
-				}
-			}
-		}
+// Server block of the request on conn: the one whose server_name matches
+// its Host, else the default one of the listener
+int Servers::serverFor(Connection &conn){
+	int server_fd = conn.getServerFd();
+	std::map<int, VirtualHosts>::iterator hosts = _virtual_hosts.find(server_fd);
+	if (hosts != _virtual_hosts.end() && hosts->second.size()) {
+		int server_idx = hosts->second.find(conn.getRequest().getHost());
+		if (server_idx >= 0)
+			return server_idx;
 	}
+	return server_fd_to_index[server_fd];
 }
 
 // Getter for config file
@@ -374,44 +1036,32 @@ int Servers::checkSocket(std::string ip){
 	return 0;
 }
 
-bool Servers::getRequest(int client_fd, std::string &request){
-	
-	char buffer[4096];
-	request.clear();
-	int bytes = recv(client_fd, buffer, sizeof(buffer) - 1, 0);
-	if (bytes > 0)
-	{
-		buffer[bytes] = '\0';
-		request.append(buffer, bytes);
-	}
+// Returns true when the client is gone and the connection should be closed
+bool Servers::getRequest(Connection &conn){
+	ssize_t bytes = conn.fill();
 	if (bytes == 0)
-	{
 		return true;
-	}
 	if (bytes == -1)
 	{
+		if (errno == EAGAIN || errno == EWOULDBLOCK)
+			return false;
 		std::cerr << "Recv failed" << std::endl;
 		return true;
 	}
 	return false;
 }
 
-size_t Servers::handleResponse(int reqStatus, int server_fd, int new_socket, HttpRequest &parser) {
-		std::string response;
-		if (reqStatus != 200)
-		{
-			Listen host_port = getTargetIpAndPort(_ip_to_server[server_fd]);
+void Servers::handleResponse(int reqStatus, Connection &conn) {
+	int server_fd = conn.getServerFd();
+	Listen host_port = getTargetIpAndPort(_ip_to_server[server_fd]);
 
-			DB db = {configDB_.getServers(), configDB_.getRootConfig()};
-			Client client(db, host_port, parser, server_fd_to_index[server_fd], reqStatus);
-			client.setupResponse();
-			response = client.getResponseString();
-		}
-		
-		ssize_t bytes = write(new_socket, response.c_str(), response.size());
-		if (bytes == -1) {
-			std::cerr << "Write failed with error: " << strerror(errno) << std::endl;
-			return 0;
-		}
-		return 1;
+	int server_idx = serverFor(conn);
+	bool keepAlive = reqStatus < 400 && _timeouts[server_idx].keepalive > 0
+		&& conn.getRequestCount() + 1 < _keepalive_requests[server_idx] && conn.getRequest().keepAlive();
+
+	Client client(*snapshot_, host_port, conn.getRequest(), server_idx, reqStatus, conn.getArena());
+	client.setKeepAlive(keepAlive);
+	client.setupResponse();
+	conn.setKeepAlive(keepAlive && !client.shouldDisconnect());
+	conn.takeResponse(client.getResponseString());
 }
@@ -0,0 +1,120 @@
+#include "../../inc/TimerWheel.hpp"
+
+Timer::Timer() : prev(NULL), next(NULL), expires(0), type(0), data(NULL)
+{
+}
+
+bool Timer::active() const
+{
+    return prev != NULL;
+}
+
+// Every slot is the sentinel of a circular list
+TimerWheel::TimerWheel(uint64_t now_ms) : current_(now_ms / TIMER_TICK_MS)
+{
+    for (size_t level = 0; level < TIMER_LEVELS; ++level)
+    {
+        for (size_t slot = 0; slot < TIMER_SLOTS; ++slot)
+        {
+            slots_[level][slot].prev = &slots_[level][slot];
+            slots_[level][slot].next = &slots_[level][slot];
+        }
+    }
+}
+
+TimerWheel::~TimerWheel() {}
+
+// (Re)arms a timer for an absolute deadline, rounded up to the next tick
+// so it never fires early
+void TimerWheel::add(Timer &timer, uint64_t expires_ms)
+{
+    remove(timer);
+    timer.expires = (expires_ms + TIMER_TICK_MS - 1) / TIMER_TICK_MS;
+    insert(timer);
+}
+
+void TimerWheel::remove(Timer &timer)
+{
+    if (!timer.active())
+        return;
+    timer.prev->next = timer.next;
+    timer.next->prev = timer.prev;
+    timer.prev = NULL;
+    timer.next = NULL;
+}
+
+// Puts a timer on the finest level whose span still reaches its expiry
+void TimerWheel::insert(Timer &timer)
+{
+    const uint64_t max_delta = (static_cast<uint64_t>(1) << (TIMER_SLOT_BITS * TIMER_LEVELS)) - 1;
+
+    if (timer.expires < current_)
+        timer.expires = current_;
+    if (timer.expires - current_ > max_delta)
+        timer.expires = current_ + max_delta;
+
+    uint64_t delta = timer.expires - current_;
+    int level = 0;
+    while (level < TIMER_LEVELS - 1 && delta >= (static_cast<uint64_t>(1) << (TIMER_SLOT_BITS * (level + 1))))
+        level++;
+    Timer &head = slots_[level][(timer.expires >> (TIMER_SLOT_BITS * level)) & (TIMER_SLOTS - 1)];
+
+    timer.next = &head;
+    timer.prev = head.prev;
+    head.prev->next = &timer;
+    head.prev = &timer;
+}
+
+// Moves the timers of one slot down to the finer levels
+void TimerWheel::cascade(int level, size_t slot)
+{
+    Timer &head = slots_[level][slot];
+    while (head.next != &head)
+    {
+        Timer &timer = *head.next;
+        remove(timer);
+        insert(timer);
+    }
+}
+
+// Collects every timer due at now_ms, unlinked from the wheel
+void TimerWheel::expire(uint64_t now_ms, std::vector<Timer *> &expired)
+{
+    uint64_t target = now_ms / TIMER_TICK_MS;
+    while (current_ <= target)
+    {
+        size_t slot = current_ & (TIMER_SLOTS - 1);
+        for (int level = 1; slot == 0 && level < TIMER_LEVELS; ++level)
+        {
+            slot = (current_ >> (TIMER_SLOT_BITS * level)) & (TIMER_SLOTS - 1);
+            cascade(level, slot);
+        }
+
+        Timer &head = slots_[0][current_ & (TIMER_SLOTS - 1)];
+        while (head.next != &head)
+        {
+            Timer &timer = *head.next;
+            remove(timer);
+            expired.push_back(&timer);
+        }
+        current_++;
+    }
+}
+
+// Milliseconds until the first busy tick of the finest level or the next
+// cascade, whichever comes first, capped at max_ms
+int TimerWheel::nextTimeout(uint64_t now_ms, int max_ms) const
+{
+    for (uint64_t tick = current_; tick < current_ + TIMER_SLOTS; ++tick)
+    {
+        const Timer &head = slots_[0][tick & (TIMER_SLOTS - 1)];
+        bool cascades = tick != current_ && (tick & (TIMER_SLOTS - 1)) == 0;
+        if (head.next == &head && !cascades)
+            continue;
+        uint64_t due = tick * TIMER_TICK_MS;
+        if (due <= now_ms)
+            return 0;
+        return static_cast<int>(std::min<uint64_t>(due - now_ms, max_ms));
+    }
+    return max_ms;
+}
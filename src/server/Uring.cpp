@@ -0,0 +1,306 @@
+#include "../../inc/Uring.hpp"
+
+#ifdef HAVE_IO_URING
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <csignal>
+
+// The ring is an array of io_uring_buf whose first resv field holds the
+// tail. Indexed by hand: in C++ the header's flexible array member sits
+// behind an empty struct and is not at offset 0.
+static struct io_uring_buf *ringBuffers(struct io_uring_buf_ring *ring)
+{
+    return reinterpret_cast<struct io_uring_buf *>(ring);
+}
+
+static void publishTail(struct io_uring_buf_ring *ring, unsigned short tail)
+{
+    __atomic_store_n(&ringBuffers(ring)[0].resv, tail, __ATOMIC_RELEASE);
+}
+
+Uring::Uring()
+    : fd_(-1), sq_ring_(MAP_FAILED), sq_ring_size_(0), cq_ring_(MAP_FAILED), cq_ring_size_(0),
+      sqes_(NULL), sqes_size_(0), sq_head_(NULL), sq_tail_(NULL), sq_array_(NULL), sq_mask_(0),
+      sq_entries_(0), sqe_tail_(0), cq_head_(NULL), cq_tail_(NULL), cq_mask_(0), cqes_(NULL),
+      buf_ring_(NULL), buf_ring_size_(0), buffers_(NULL), buf_tail_(0)
+{
+}
+
+Uring::~Uring()
+{
+    if (fd_ != -1)
+        close(fd_);
+    if (sqes_ != NULL)
+        munmap(sqes_, sqes_size_);
+    if (cq_ring_ != MAP_FAILED && cq_ring_ != sq_ring_)
+        munmap(cq_ring_, cq_ring_size_);
+    if (sq_ring_ != MAP_FAILED)
+        munmap(sq_ring_, sq_ring_size_);
+    if (buf_ring_ != NULL)
+        munmap(buf_ring_, buf_ring_size_);
+    delete[] buffers_;
+}
+
+// Creates the rings; false when the kernel (or a seccomp filter) refuses
+bool Uring::setup(unsigned entries)
+{
+    struct io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    // only this thread submits, and completions are run when it waits
+    params.flags = IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN | IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN;
+    fd_ = syscall(__NR_io_uring_setup, entries, &params);
+    if (fd_ == -1 && errno == EINVAL)
+    {
+        std::memset(&params, 0, sizeof(params));
+        fd_ = syscall(__NR_io_uring_setup, entries, &params);
+    }
+    if (fd_ == -1)
+    {
+        std::cerr << "io_uring_setup failed: " << strerror(errno) << std::endl;
+        return false;
+    }
+    if (!(params.features & IORING_FEAT_EXT_ARG))
+    {
+        std::cerr << "io_uring: kernel lacks IORING_FEAT_EXT_ARG" << std::endl;
+        return false;
+    }
+
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+        sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+    sq_ring_ = mmap(NULL, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+    if (sq_ring_ == MAP_FAILED)
+        return false;
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+        cq_ring_ = sq_ring_;
+    else
+        cq_ring_ = mmap(NULL, cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_CQ_RING);
+    if (cq_ring_ == MAP_FAILED)
+        return false;
+    sqes_size_ = params.sq_entries * sizeof(struct io_uring_sqe);
+    void *sqes = mmap(NULL, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED)
+        return false;
+    sqes_ = static_cast<struct io_uring_sqe *>(sqes);
+
+    char *sq = static_cast<char *>(sq_ring_);
+    char *cq = static_cast<char *>(cq_ring_);
+    sq_head_ = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+    sq_tail_ = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    sq_array_ = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+    sq_mask_ = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    sq_entries_ = params.sq_entries;
+    sqe_tail_ = *sq_tail_;
+    cq_head_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<struct io_uring_cqe *>(cq + params.cq_off.cqes);
+
+    return setupBuffers();
+}
+
+// Registers URING_BUFFERS recv buffers the kernel picks from on its own
+bool Uring::setupBuffers()
+{
+    buf_ring_size_ = URING_BUFFERS * sizeof(struct io_uring_buf);
+    void *ring = mmap(NULL, buf_ring_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ring == MAP_FAILED)
+        return false;
+    buf_ring_ = static_cast<struct io_uring_buf_ring *>(ring);
+
+    struct io_uring_buf_reg reg;
+    std::memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = reinterpret_cast<uint64_t>(buf_ring_);
+    reg.ring_entries = URING_BUFFERS;
+    reg.bgid = URING_BUFFER_GROUP;
+    if (syscall(__NR_io_uring_register, fd_, IORING_REGISTER_PBUF_RING, &reg, 1) == -1)
+    {
+        std::cerr << "io_uring: provided buffer ring failed: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    buffers_ = new char[URING_BUFFERS * URING_BUFFER_SIZE];
+    for (unsigned bid = 0; bid < URING_BUFFERS; ++bid)
+    {
+        struct io_uring_buf &buf = ringBuffers(buf_ring_)[bid];
+        buf.addr = reinterpret_cast<uint64_t>(buffers_ + bid * URING_BUFFER_SIZE);
+        buf.len = URING_BUFFER_SIZE;
+        buf.bid = bid;
+    }
+    buf_tail_ = URING_BUFFERS;
+    publishTail(buf_ring_, buf_tail_);
+    return true;
+}
+
+// Next free submission entry, flushing the queue to the kernel when it is full
+struct io_uring_sqe *Uring::nextSqe()
+{
+    if (sqe_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) >= sq_entries_)
+        enter(sqe_tail_ - *sq_tail_, 0, 0, NULL, 0);
+
+    unsigned index = sqe_tail_ & sq_mask_;
+    struct io_uring_sqe *sqe = &sqes_[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sq_array_[index] = index;
+    sqe_tail_++;
+    return sqe;
+}
+
+// Publishes the queued entries, then submits and/or waits for completions
+int Uring::enter(unsigned to_submit, unsigned min_complete, unsigned flags, const void *arg, size_t arg_size)
+{
+    __atomic_store_n(sq_tail_, sqe_tail_, __ATOMIC_RELEASE);
+    return syscall(__NR_io_uring_enter, fd_, to_submit, min_complete, flags, arg, arg_size);
+}
+
+void Uring::accept(int fd, uint64_t user_data)
+{
+    struct io_uring_sqe *sqe = nextSqe();
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe->user_data = user_data;
+}
+
+void Uring::recv(int fd, uint64_t user_data)
+{
+    struct io_uring_sqe *sqe = nextSqe();
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BUFFER_GROUP;
+    sqe->user_data = user_data;
+}
+
+// data must stay untouched until the completion arrives
+void Uring::sendmsg(int fd, const struct msghdr *msg, uint64_t user_data)
+{
+    struct io_uring_sqe *sqe = nextSqe();
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(msg);
+    sqe->len = 1;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = user_data;
+}
+
+// Cancels the request queued with user_data target; only a failure completes
+void Uring::cancel(uint64_t target, uint64_t user_data)
+{
+    struct io_uring_sqe *sqe = nextSqe();
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->addr = target;
+    sqe->flags = IOSQE_CQE_SKIP_SUCCESS;
+    sqe->user_data = user_data;
+}
+
+// Cancels every request still pending on fd, then closes it. The hard link
+// keeps the close even when there was nothing to cancel.
+void Uring::cancelAndClose(int fd, uint64_t user_data)
+{
+    struct io_uring_sqe *sqe = nextSqe();
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = fd;
+    sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+    sqe->flags = IOSQE_IO_HARDLINK | IOSQE_CQE_SKIP_SUCCESS;
+    sqe->user_data = user_data;
+
+    sqe = nextSqe();
+    sqe->opcode = IORING_OP_CLOSE;
+    sqe->fd = fd;
+    sqe->flags = IOSQE_CQE_SKIP_SUCCESS;
+    sqe->user_data = user_data;
+}
+
+// Submits everything queued and waits up to timeout_ms (-1: forever) for a completion
+int Uring::wait(int timeout_ms)
+{
+    struct __kernel_timespec ts;
+    struct io_uring_getevents_arg arg;
+    std::memset(&arg, 0, sizeof(arg));
+    arg.sigmask_sz = _NSIG / 8;
+    if (timeout_ms >= 0)
+    {
+        ts.tv_sec = timeout_ms / 1000;
+        ts.tv_nsec = (timeout_ms % 1000) * 1000000L;
+        arg.ts = reinterpret_cast<uint64_t>(&ts);
+    }
+    int ret = enter(sqe_tail_ - *sq_tail_, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+    if (ret == -1 && (errno == ETIME || errno == EINTR || errno == EBUSY))
+        return 0;
+    return ret;
+}
+
+void Uring::reap(std::vector<UringCompletion> &completions)
+{
+    unsigned head = *cq_head_;
+    unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+
+    completions.clear();
+    for (; head != tail; ++head)
+    {
+        const struct io_uring_cqe &cqe = cqes_[head & cq_mask_];
+        UringCompletion completion = {cqe.user_data, cqe.res, cqe.flags};
+        completions.push_back(completion);
+    }
+    __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+}
+
+// A multishot request stays armed while its completions carry F_MORE
+bool Uring::hasMore(const UringCompletion &completion) const
+{
+    return completion.flags & IORING_CQE_F_MORE;
+}
+
+bool Uring::hasBuffer(const UringCompletion &completion) const
+{
+    return completion.flags & IORING_CQE_F_BUFFER;
+}
+
+const char *Uring::buffer(const UringCompletion &completion) const
+{
+    return buffers_ + (completion.flags >> IORING_CQE_BUFFER_SHIFT) * URING_BUFFER_SIZE;
+}
+
+// Hands a consumed recv buffer back to the kernel
+void Uring::recycle(const UringCompletion &completion)
+{
+    unsigned bid = completion.flags >> IORING_CQE_BUFFER_SHIFT;
+    struct io_uring_buf &buf = ringBuffers(buf_ring_)[buf_tail_ & (URING_BUFFERS - 1)];
+    buf.addr = reinterpret_cast<uint64_t>(buffers_ + bid * URING_BUFFER_SIZE);
+    buf.len = URING_BUFFER_SIZE;
+    buf.bid = bid;
+    buf_tail_++;
+    publishTail(buf_ring_, buf_tail_);
+}
+
+#else
+
+Uring::Uring() : fd_(-1) {}
+Uring::~Uring() {}
+
+bool Uring::setup(unsigned entries)
+{
+    (void)entries;
+    std::cerr << "io_uring support was not compiled in" << std::endl;
+    return false;
+}
+
+void Uring::accept(int, uint64_t) {}
+void Uring::recv(int, uint64_t) {}
+void Uring::sendmsg(int, const struct msghdr *, uint64_t) {}
+void Uring::cancel(uint64_t, uint64_t) {}
+void Uring::cancelAndClose(int, uint64_t) {}
+int Uring::wait(int) { return -1; }
+void Uring::reap(std::vector<UringCompletion> &completions) { completions.clear(); }
+bool Uring::hasMore(const UringCompletion &) const { return false; }
+bool Uring::hasBuffer(const UringCompletion &) const { return false; }
+const char *Uring::buffer(const UringCompletion &) const { return NULL; }
+void Uring::recycle(const UringCompletion &) {}
+
+#endif
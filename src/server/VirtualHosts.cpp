@@ -0,0 +1,146 @@
+#include "../../inc/VirtualHosts.hpp"
+
+// Host names are ASCII, no need for the locale of tolower
+static char lower(char c)
+{
+    return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+}
+
+// FNV-1a over the lowercase bytes, Host values are compared caseless
+static size_t hashName(const char *name, size_t len)
+{
+    size_t hash = 2166136261u;
+    for (size_t i = 0; i < len; ++i)
+    {
+        hash ^= static_cast<unsigned char>(lower(name[i]));
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static bool sameName(const std::string &stored, const char *name, size_t len)
+{
+    if (stored.size() != len)
+        return false;
+    for (size_t i = 0; i < len; ++i)
+    {
+        if (stored[i] != lower(name[i]))
+            return false;
+    }
+    return true;
+}
+
+VirtualHosts::Table::Slot::Slot() : server(-1)
+{
+}
+
+VirtualHosts::Table::Table() : used_(0)
+{
+}
+
+void VirtualHosts::Table::grow()
+{
+    std::vector<Slot> old;
+    old.swap(slots_);
+    slots_.resize(old.empty() ? 16 : old.size() * 2);
+    used_ = 0;
+    for (size_t i = 0; i < old.size(); ++i)
+    {
+        if (old[i].server >= 0)
+            insert(old[i].name, old[i].server);
+    }
+}
+
+// False if the name is taken already, the first server naming it keeps it
+bool VirtualHosts::Table::insert(const std::string &name, int server)
+{
+    if ((used_ + 1) * 2 > slots_.size())
+        grow();
+    size_t mask = slots_.size() - 1;
+    for (size_t i = hashName(name.data(), name.size()) & mask;; i = (i + 1) & mask)
+    {
+        if (slots_[i].server < 0)
+        {
+            slots_[i].name = name;
+            slots_[i].server = server;
+            ++used_;
+            return true;
+        }
+        if (slots_[i].name == name)
+            return false;
+    }
+}
+
+int VirtualHosts::Table::find(const char *name, size_t len) const
+{
+    if (used_ == 0)
+        return -1;
+    size_t mask = slots_.size() - 1;
+    for (size_t i = hashName(name, len) & mask; slots_[i].server >= 0; i = (i + 1) & mask)
+    {
+        if (sameName(slots_[i].name, name, len))
+            return slots_[i].server;
+    }
+    return -1;
+}
+
+size_t VirtualHosts::Table::size() const
+{
+    return used_;
+}
+
+// False if an earlier server already holds the whole name
+bool VirtualHosts::add(const std::string &name, int server)
+{
+    std::string key(name);
+    for (size_t i = 0; i < key.size(); ++i)
+        key[i] = lower(key[i]);
+
+    if (key.size() > 2 && key.compare(0, 2, "*.") == 0)
+        return leading_.insert(key.substr(2), server);
+    if (key.size() > 2 && key.compare(key.size() - 2, 2, ".*") == 0)
+        return trailing_.insert(key.substr(0, key.size() - 2), server);
+    if (key.size() > 1 && key[0] == '.')
+    {
+        // used as soon as either half is free, like two separate names
+        bool exact = exact_.insert(key.substr(1), server);
+        bool leading = leading_.insert(key.substr(1), server);
+        return exact || leading;
+    }
+    return exact_.insert(key, server);
+}
+
+// Server of a Host value ("Example.com:8080", "[::1]:80", "example.com."),
+// -1 if no name matches
+int VirtualHosts::find(const std::string &host) const
+{
+    const char *name = host.data();
+    size_t len = host.size();
+    int server;
+
+    if (len > 0 && name[0] == '[')
+        len = host.find(']') == std::string::npos ? len : host.find(']') + 1;
+    else if (host.find(':') != std::string::npos)
+        len = host.find(':');
+    if (len > 1 && name[len - 1] == '.')
+        --len;
+
+    if ((server = exact_.find(name, len)) >= 0)
+        return server;
+    for (size_t dot = 0; leading_.size() && dot < len; ++dot)
+    {
+        if (name[dot] == '.' && (server = leading_.find(name + dot + 1, len - dot - 1)) >= 0)
+            return server;
+    }
+    for (size_t dot = len; trailing_.size() && dot-- > 0;)
+    {
+        if (name[dot] == '.' && (server = trailing_.find(name, dot)) >= 0)
+            return server;
+    }
+    return -1;
+}
+
+size_t VirtualHosts::size() const
+{
+    return exact_.size() + leading_.size() + trailing_.size();
+}
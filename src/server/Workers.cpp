@@ -0,0 +1,223 @@
+#include "../../inc/AllHeaders.hpp"
+#include "../../inc/Workers.hpp"
+#include <sys/resource.h>
+#include <csignal>
+
+Workers::Workers(const ConfigDB &configDB) : configDB_(configDB), count_(countFromConfig(configDB)), stop_(false)
+{
+    pids_.assign(count_, -1);
+    started_.assign(count_, 0);
+    respawn_at_.assign(count_, 0);
+    sigemptyset(&signals_);
+    sigaddset(&signals_, SIGCHLD);
+    sigaddset(&signals_, SIGINT);
+    sigaddset(&signals_, SIGTERM);
+}
+
+Workers::~Workers() {}
+
+// worker_processes N | auto, defaults to a single process
+int Workers::countFromConfig(const ConfigDB &configDB)
+{
+    std::string value = configDB.getRootDirective("worker_processes");
+    if (value == "auto")
+    {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        return cpus > 0 ? static_cast<int>(cpus) : 1;
+    }
+    int count = std::atoi(value.c_str());
+    return count > 0 ? count : 1;
+}
+
+// worker_threads N, event loops run by each process
+int Workers::threadsFromConfig(const ConfigDB &configDB)
+{
+    int count = std::atoi(configDB.getRootDirective("worker_threads").c_str());
+    return count > 0 ? count : 1;
+}
+
+// Returns non-NULL when the thread's loop could not start
+static void *serveThread(void *arg)
+{
+    Servers servers(*static_cast<const ConfigDB *>(arg));
+    return servers.failed() ? arg : NULL;
+}
+
+// Runs this process' event loops: one inline, or one per worker thread.
+// Returns 1 when none of them could start, the exit status of the process.
+int Workers::serve(const ConfigDB &configDB)
+{
+    size_t threads = threadsFromConfig(configDB);
+    if (threads <= 1)
+    {
+        Servers servers(configDB);
+        return servers.failed() ? 1 : 0;
+    }
+
+    std::vector<pthread_t> ids;
+    for (size_t i = 0; i < threads; ++i)
+    {
+        pthread_t id;
+        int err = pthread_create(&id, NULL, serveThread, const_cast<ConfigDB *>(&configDB));
+        if (err != 0)
+        {
+            std::cerr << "pthread_create failed: " << strerror(err) << std::endl;
+            continue;
+        }
+        ids.push_back(id);
+    }
+    // a loop that failed leaves the others serving
+    size_t started = 0;
+    for (size_t i = 0; i < ids.size(); ++i)
+    {
+        void *failed = NULL;
+        pthread_join(ids[i], &failed);
+        if (!failed)
+            started++;
+    }
+    return started ? 0 : 1;
+}
+
+// worker_rlimit_nofile N raises the descriptor limit inherited by the workers
+void Workers::setFileLimit(const ConfigDB &configDB)
+{
+    std::string value = configDB.getRootDirective("worker_rlimit_nofile");
+    if (value.empty())
+        return;
+
+    struct rlimit limit;
+    rlim_t wanted = std::strtoul(value.c_str(), NULL, 10);
+    if (wanted == 0 || getrlimit(RLIMIT_NOFILE, &limit) == -1)
+        return;
+    limit.rlim_cur = wanted;
+    if (limit.rlim_max != RLIM_INFINITY && limit.rlim_max < wanted)
+        limit.rlim_max = wanted;
+    if (setrlimit(RLIMIT_NOFILE, &limit) == -1)
+    {
+        // raising the hard limit needs privileges, fall back to the soft one
+        getrlimit(RLIMIT_NOFILE, &limit);
+        limit.rlim_cur = std::min(wanted, limit.rlim_max);
+        if (setrlimit(RLIMIT_NOFILE, &limit) == -1)
+            std::cerr << "setrlimit failed: " << strerror(errno) << std::endl;
+        std::cerr << "worker_rlimit_nofile limited to " << limit.rlim_cur << std::endl;
+    }
+}
+
+pid_t Workers::spawn(size_t slot)
+{
+    pid_t pid = fork();
+    if (pid == -1)
+    {
+        std::cerr << "Error: fork failed: " << strerror(errno) << std::endl;
+        return -1;
+    }
+    if (pid == 0)
+    {
+        sigprocmask(SIG_UNBLOCK, &signals_, NULL);
+        exit(serve(configDB_));
+    }
+    pids_[slot] = pid;
+    started_[slot] = time(NULL);
+    std::cout << "Worker " << slot << " started, pid " << pid << std::endl;
+    return pid;
+}
+
+// Respawn a worker killed by a signal; a worker that exits on its own
+// failed to start (e.g. no listener could be bound) and is not restarted.
+void Workers::reap(pid_t pid, int status)
+{
+    for (size_t slot = 0; slot < pids_.size(); ++slot)
+    {
+        if (pids_[slot] != pid)
+            continue;
+        pids_[slot] = -1;
+        if (!WIFSIGNALED(status))
+        {
+            std::cerr << "Worker " << slot << " exited with status " << WEXITSTATUS(status) << std::endl;
+            return;
+        }
+        std::cerr << "Worker " << slot << " killed by signal " << WTERMSIG(status) << ", respawning" << std::endl;
+        // avoid a fork loop when a worker crashes on startup
+        if (time(NULL) - started_[slot] < 1)
+            respawn_at_[slot] = time(NULL) + 1;
+        else
+            spawn(slot);
+        return;
+    }
+}
+
+// Forks the workers whose respawn delay is over. Returns the seconds until
+// the next one is due, -1 when none is waiting.
+int Workers::respawnDue()
+{
+    time_t now = time(NULL);
+    int next = -1;
+    for (size_t slot = 0; slot < respawn_at_.size(); ++slot)
+    {
+        if (!respawn_at_[slot])
+            continue;
+        if (respawn_at_[slot] <= now)
+        {
+            respawn_at_[slot] = 0;
+            spawn(slot);
+        }
+        else if (next == -1 || respawn_at_[slot] - now < next)
+            next = respawn_at_[slot] - now;
+    }
+    return next;
+}
+
+// Sleeps until a worker exits, a stop signal arrives or timeout_sec (-1:
+// none) passed. The signals stay blocked and are only taken here, so one
+// arriving between two waits is never lost.
+void Workers::waitSignal(int timeout_sec)
+{
+    struct timespec timeout;
+    timeout.tv_sec = timeout_sec;
+    timeout.tv_nsec = 0;
+    int sig = sigtimedwait(&signals_, NULL, timeout_sec >= 0 ? &timeout : NULL);
+    if (sig == SIGINT || sig == SIGTERM)
+        stop_ = true;
+}
+
+bool Workers::running() const
+{
+    for (size_t slot = 0; slot < pids_.size(); ++slot)
+    {
+        if (pids_[slot] > 0 || respawn_at_[slot])
+            return true;
+    }
+    return false;
+}
+
+void Workers::shutdown()
+{
+    for (size_t slot = 0; slot < pids_.size(); ++slot)
+    {
+        if (pids_[slot] > 0)
+            kill(pids_[slot], SIGTERM);
+    }
+    while (waitpid(-1, NULL, 0) > 0 || errno == EINTR)
+        ;
+}
+
+void Workers::run()
+{
+    sigprocmask(SIG_BLOCK, &signals_, NULL);
+    setFileLimit(configDB_);
+    for (size_t slot = 0; slot < count_; ++slot)
+        spawn(slot);
+
+    while (!stop_)
+    {
+        int status;
+        pid_t pid;
+        while ((pid = waitpid(-1, &status, WNOHANG)) > 0)
+            reap(pid, status);
+        int next = respawnDue();
+        if (!running())
+            break;
+        waitSignal(next);
+    }
+    shutdown();
+}
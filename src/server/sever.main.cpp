@@ -11,6 +11,8 @@
 /* ************************************************************************** */
 
 #include "../../inc/AllHeaders.hpp"
+#include "../../inc/Workers.hpp"
+#include <csignal>
 
 int serverMain(int argc, char **argv) {
       if (argc < 2)
@@ -28,7 +30,13 @@ int serverMain(int argc, char **argv) {
      * @return NULL;
      */
     base.printChoice(false, -1, false, -1, false);
-    Servers servers(base);
-
-    return 0;
+    signal(SIGPIPE, SIG_IGN);
+    if (Workers::countFromConfig(base) > 1)
+    {
+        Workers master(base);
+        master.run();
+        return 0;
+    }
+    Workers::setFileLimit(base);
+    return Workers::serve(base);
 }
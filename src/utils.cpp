@@ -173,7 +173,7 @@ std::string ftos(size_t num)
     return oss.str();
 }
 
-std::string removeDupSlashes(std::string str)
+std::string removeDupSlashes(const std::string &str)
 {
     if (str.empty())
         return str;
@@ -208,13 +208,14 @@ std::string removeDupSlashes(std::string str)
 std::string formatHttpDate(time_t timeValue)
 {
     char buf[32];
-    struct tm *timeinfo = gmtime(&timeValue);
+    struct tm timeinfo;
+    gmtime_r(&timeValue, &timeinfo);
 
     // Adjust for CEST => should be +2 hours but for some weird reason +4 works
-    timeinfo->tm_hour += 4;
-    mktime(timeinfo);
+    timeinfo.tm_hour += 4;
+    mktime(&timeinfo);
 
-    strftime(buf, sizeof(buf), "%a, %d %b %Y %T GMT", timeinfo);
+    strftime(buf, sizeof(buf), "%a, %d %b %Y %T GMT", &timeinfo);
     return std::string(buf);
 }
 
@@ -227,6 +228,56 @@ std::string get_http_date()
     return formatHttpDate(currentTime);
 }
 
+// Milliseconds on a clock that never jumps, for deadlines only
+uint64_t monotonicMsec()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+}
+
+// nginx time values: "500ms", "30s", "5m", "1h"; a bare number is seconds
+uint64_t parseMsec(const std::string &value)
+{
+    char *end = NULL;
+    uint64_t amount = std::strtoul(value.c_str(), &end, 10);
+    std::string unit(end);
+
+    if (unit == "ms")
+        return amount;
+    if (unit == "m")
+        return amount * 60 * 1000;
+    if (unit == "h")
+        return amount * 60 * 60 * 1000;
+    return amount * 1000;
+}
+
+// nginx size values: "512", "16k", "8m", "1g". False for a sign, an
+// unknown unit or a size that does not fit in size_t.
+bool parseSize(const std::string &value, size_t &size)
+{
+    if (value.empty() || !isDigit(value[0]))
+        return false;
+
+    char *end = NULL;
+    errno = 0;
+    unsigned long amount = std::strtoul(value.c_str(), &end, 10);
+    size_t scale = 1;
+    if (*end == 'k' || *end == 'K')
+        scale = 1024;
+    else if (*end == 'm' || *end == 'M')
+        scale = 1024 * 1024;
+    else if (*end == 'g' || *end == 'G')
+        scale = 1024 * 1024 * 1024;
+    if (scale > 1)
+        ++end;
+
+    if (errno == ERANGE || *end || amount > std::numeric_limits<size_t>::max() / scale)
+        return false;
+    size = amount * scale;
+    return true;
+}
+
 std::string generateETagForFile(File &file)
 {
     std::stringstream ss;